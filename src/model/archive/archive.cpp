@@ -20,7 +20,149 @@
  */
 #include "archive.hpp"
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QMutex>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <cerrno>
+#include <csignal>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#endif
+
+#include <algorithm>
+
+namespace {
+/// book.7z.001 and book.part1.rar, the number is captured
+const char * const NUMBERED_VOLUME = "^(.+\\.(?:7z|zip|cbz))\\.(\\d+)$";
+const char * const RAR_VOLUME = "^(.+)\\.part(\\d+)\\.rar$";
+/// size of sampled head and tail blocks
+const qint64 SAMPLE_SIZE = 64 * 1024;
+/// files removed between pauses
+const int SWEEP_BATCH = 64;
+/// pause between batches, in msecs
+const unsigned long SWEEP_PAUSE = 10;
+const char * const TMP_PREFIX = "komix_";
+const char * const TRASH_PREFIX = ".komix_trash_";
+
+bool isAlive(qint64 pid) {
+#if defined(Q_OS_UNIX)
+    return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#elif defined(Q_OS_WIN32)
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!process) {
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    }
+    DWORD code = 0;
+    BOOL ok = GetExitCodeProcess(process, &code);
+    CloseHandle(process);
+    return !ok || code == STILL_ACTIVE;
+#else
+    // can not tell, keep it
+    return true;
+#endif
+}
+
+/// deletes queued trees, slowly
+class Sweeper : public QThread {
+public:
+    Sweeper()
+        : QThread()
+        , lock()
+        , queue()
+        , active(false)
+        , stopped(false) {
+    }
+
+    void push(const QString & path) {
+        QMutexLocker locker(&this->lock);
+        this->queue.append(path);
+        if (!this->active && !this->stopped) {
+            this->active = true;
+            // the previous run may be returning
+            this->wait();
+            this->start(QThread::LowestPriority);
+        }
+    }
+
+    void stop() {
+        {
+            QMutexLocker locker(&this->lock);
+            this->stopped = true;
+        }
+        this->requestInterruption();
+        this->wait();
+    }
+
+protected:
+    virtual void run() {
+#ifdef Q_OS_LINUX
+        // idle I/O class for this thread, never delays page reads
+        syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+        int count = 0;
+        for (;;) {
+            QString path;
+            {
+                QMutexLocker locker(&this->lock);
+                if (this->queue.isEmpty() || this->isInterruptionRequested()) {
+                    this->active = false;
+                    return;
+                }
+                path = this->queue.takeFirst();
+            }
+            this->sweep(path, count);
+        }
+    }
+
+private:
+    bool sweep(const QString & path, int & count) {
+        QDir dir(path);
+        QFileInfoList entries = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Files | QDir::Dirs | QDir::Hidden | QDir::System);
+        foreach (QFileInfo e, entries) {
+            if (this->isInterruptionRequested()) {
+                return false;
+            }
+            if (e.isDir() && !e.isSymLink()) {
+                if (!this->sweep(e.absoluteFilePath(), count)) {
+                    return false;
+                }
+                continue;
+            }
+            QFile::remove(e.absoluteFilePath());
+            if (++count % SWEEP_BATCH == 0) {
+                QThread::msleep(SWEEP_PAUSE);
+            }
+        }
+        dir.rmdir(dir.absolutePath());
+        return true;
+    }
+
+    QMutex lock;
+    QStringList queue;
+    bool active;
+    bool stopped;
+};
+
+Sweeper & sweeper() {
+    static Sweeper s;
+    return s;
+}
+
+} // end of namespace
 
 namespace KomiX {
 namespace model {
@@ -28,9 +170,13 @@ namespace archive {
 
 // one-shot action
 QDir createTmpDir() {
-    qsrand(qApp->applicationPid());
-    QString tmpPath(QString("komix_%1").arg(qrand()));
+    // named by pid, so it can be told stale after a crash
+    QString tmpPath(QString("%1%2").arg(TMP_PREFIX).arg(qApp->applicationPid()));
     QDir tmpDir(QDir::temp());
+    if (tmpDir.exists(tmpPath)) {
+        // left by a dead process with the same pid
+        delTreeLater(tmpDir.filePath(tmpPath));
+    }
     if (!tmpDir.mkdir(tmpPath)) {
         qWarning("can not make temp dir");
         // tmpDir will remain to tmp dir
@@ -60,6 +206,110 @@ int delTree(const QDir & dir) {
     dir.rmdir(dir.absolutePath());
     return sum + 1;
 }
+
+QString delTreeLater(const QDir & dir) {
+    static QAtomicInt serial;
+    QString path = dir.absolutePath();
+    QString trash = QFileInfo(path).dir().filePath(
+        QString("%1%2_%3").arg(TRASH_PREFIX).arg(qApp->applicationPid()).arg(serial.fetchAndAddRelaxed(1)));
+    if (QDir().rename(path, trash)) {
+        path = trash;
+    }
+    sweeper().push(path);
+    return path;
+}
+
+void sweepStale(const QDir & dir) {
+    QStringList names = dir.entryList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+    foreach (QString name, names) {
+        QString pid;
+        if (name.startsWith(TRASH_PREFIX)) {
+            pid = name.mid(qstrlen(TRASH_PREFIX)).section('_', 0, 0);
+        } else if (name.startsWith(TMP_PREFIX)) {
+            pid = name.mid(qstrlen(TMP_PREFIX));
+        } else {
+            continue;
+        }
+        bool ok = false;
+        qint64 id = pid.toLongLong(&ok);
+        if (!ok || id == qApp->applicationPid() || isAlive(id)) {
+            continue;
+        }
+        sweeper().push(dir.filePath(name));
+    }
+}
+
+void stopSweeping() {
+    sweeper().stop();
+}
+
+QString getArchiveKey(const QFileInfo & file) {
+    QByteArray meta;
+    QDataStream out(&meta, QIODevice::WriteOnly);
+    out << file.size() << file.lastModified().toMSecsSinceEpoch();
+    foreach (QString volume, listVolumes(file).mid(1)) {
+        // any volume replaced changes the set
+        QFileInfo info(volume);
+        out << info.size() << info.lastModified().toMSecsSinceEpoch();
+    }
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(file.absoluteFilePath()).constData(), &st) == 0) {
+        out << static_cast<quint64>(st.st_dev) << static_cast<quint64>(st.st_ino);
+    }
+#endif
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(meta);
+    QFile fin(file.absoluteFilePath());
+    if (fin.open(QIODevice::ReadOnly)) {
+        hash.addData(fin.read(SAMPLE_SIZE));
+        if (fin.size() > SAMPLE_SIZE) {
+            // most archive formats keep their directory at the end
+            fin.seek(std::max(SAMPLE_SIZE, fin.size() - SAMPLE_SIZE));
+            hash.addData(fin.read(SAMPLE_SIZE));
+        }
+    }
+    return QString::fromUtf8(hash.result().toHex());
+}
+
+QStringList listVolumes(const QFileInfo & first) {
+    QStringList volumes(first.absoluteFilePath());
+    QString name = first.fileName();
+    QString pattern;
+    QRegularExpressionMatch m = QRegularExpression(NUMBERED_VOLUME, QRegularExpression::CaseInsensitiveOption).match(name);
+    if (m.hasMatch()) {
+        pattern = m.captured(1) + ".%1";
+    } else {
+        m = QRegularExpression(RAR_VOLUME, QRegularExpression::CaseInsensitiveOption).match(name);
+        if (!m.hasMatch()) {
+            return volumes;
+        }
+        pattern = m.captured(1) + ".part%1" + name.right(4);
+    }
+    if (m.captured(2).toInt() != 1) {
+        return volumes;
+    }
+    // the following ones are numbered with the same width
+    int width = m.captured(2).size();
+    QDir dir = first.dir();
+    for (int i = 2;; ++i) {
+        QString path = dir.absoluteFilePath(pattern.arg(i, width, 10, QChar('0')));
+        if (!QFileInfo(path).isFile()) {
+            break;
+        }
+        volumes << path;
+    }
+    return volumes;
+}
+
+bool isTrailingVolume(const QString & name) {
+    QRegularExpressionMatch m = QRegularExpression(NUMBERED_VOLUME).match(name);
+    if (!m.hasMatch()) {
+        m = QRegularExpression(RAR_VOLUME).match(name);
+    }
+    return m.hasMatch() && m.captured(2).toInt() > 1;
+}
 }
 }
 }
@@ -21,14 +21,74 @@
 #ifndef KOMIX_MODEL_ARCHIVE_ARCHIVE_HPP
 #define KOMIX_MODEL_ARCHIVE_ARCHIVE_HPP
 
+#include "exception.hpp"
+
 #include <QtCore/QDir>
 
 namespace KomiX {
+namespace exception {
+
+/// Archive error class
+class ArchiveException : public Exception {
+public:
+    ArchiveException(const char * msg)
+        : Exception(msg) {
+    }
+    ArchiveException(const QString & msg)
+        : Exception(msg) {
+    }
+};
+}
+
 namespace model {
 namespace archive {
 
 const QDir & getTmpDir();
 int delTree(const QDir & dir);
+
+/**
+ * @brief Delete @p dir in background
+ *
+ * The directory is renamed to a trash name at once, so its path can be
+ * reused immediately. Files are removed by a low priority thread in
+ * small batches, and whatever is left on exit is swept next time.
+ *
+ * @return the path it is deleted from
+ */
+QString delTreeLater(const QDir & dir);
+/**
+ * @brief Delete directories left in @p dir by sessions which are gone
+ *
+ * Both temporary directories and trash of dead processes are deleted,
+ * in background as delTreeLater().
+ */
+void sweepStale(const QDir & dir);
+/// Stop background deletion, must be called before exit
+void stopSweeping();
+
+/**
+ * @brief Get the identity of archive @p file
+ *
+ * The key is derived from size, modification time, device and inode,
+ * and the first and last blocks of the content. It changes when the
+ * archive is replaced or updated, but does not depend on the file name.
+ * The whole file is never read.
+ */
+QString getArchiveKey(const QFileInfo & file);
+
+/**
+ * @brief List the volumes of the split archive which @p first begins
+ *
+ * Sets named like book.7z.001, book.7z.002 or book.part1.rar,
+ * book.part2.rar are listed in order until a volume is missing.
+ * Other files are listed alone.
+ */
+QStringList listVolumes(const QFileInfo & first);
+/**
+ * @brief Check if @p name is a volume of a split archive but not the first one
+ * @param name lower case file name
+ */
+bool isTrailingVolume(const QString & name);
 }
 }
 }
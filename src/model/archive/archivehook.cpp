@@ -21,6 +21,8 @@
 #include "archivehook.hpp"
 #include "archive.hpp"
 #include "archivemodel.hpp"
+#include "contentstore.hpp"
+#include "extractioncache.hpp"
 #include "global.hpp"
 
 #include <QtCore/QCoreApplication>
@@ -57,8 +59,16 @@ ArchiveHook::ArchiveHook(QWidget * parent)
     connect(this, SIGNAL(triggered()), this, SLOT(helper_()));
     connect(this, SIGNAL(opened(const QUrl &)), parent, SLOT(open(const QUrl &)));
 
-    // cleanup temporary dir on exit
+    // cleanup temporary dir and trim cache on exit
     this->connect(qApp, SIGNAL(aboutToQuit()), SLOT(cleanup_()));
+
+    // remove what crashed or interrupted sessions left
+    sweepStale(QDir::temp());
+    if (ExtractionCache::instance().isPrepared()) {
+        sweepStale(ExtractionCache::instance().getRoot());
+    }
+    // pages of archives evicted last time
+    ContentStore::instance().collect();
 }
 
 void ArchiveHook::helper_() {
@@ -69,5 +79,10 @@ void ArchiveHook::helper_() {
 }
 
 void ArchiveHook::cleanup_() {
-    delTree(getTmpDir());
+    // only renamed here, quitting does not wait for deletion
+    delTreeLater(getTmpDir());
+    // extracted files are kept for next session, within the budget
+    ExtractionCache::instance().evict();
+    // unfinished trees are swept next time
+    stopSweeping();
 }
@@ -21,32 +21,31 @@
 #include "archive.hpp"
 #include "archivehook.hpp"
 #include "archivemodel_p.hpp"
+#include "contentstore.hpp"
 #include "exception.hpp"
+#include "extractioncache.hpp"
+#include "extractionscheduler.hpp"
 #include "global.hpp"
+#include "gzipreader.hpp"
+#include "journal.hpp"
+#include "libarchivemodel.hpp"
+#include "localfilemodel.hpp"
+#include "memorystore.hpp"
+#include "tableofcontents.hpp"
+#include "tarextractor.hpp"
+#include "zipmodel.hpp"
 
-#include <QtCore/QCryptographicHash>
 #include <QtCore/QDir>
+#include <QtCore/QDirIterator>
 #include <QtCore/QProcess>
+#include <QtCore/QSet>
+#include <QtCore/QSettings>
 #include <QtCore/QStandardPaths>
 #include <QtCore/QtDebug>
 #include <QtGui/QPixmap>
 #include <QtWidgets/QApplication>
 
-namespace KomiX {
-namespace exception {
-
-/// Private archive error class
-class ArchiveException : public Exception {
-public:
-    ArchiveException(const char * msg)
-        : Exception(msg) {
-    }
-    ArchiveException(const QString & msg)
-        : Exception(msg) {
-    }
-};
-}
-} // end of namespace
+#include <algorithm>
 
 namespace {
 
@@ -60,13 +59,55 @@ bool check(const QUrl & url) {
     return false;
 }
 
+/// compressed tarballs are unpacked in process
+bool isCompressedTar(const QString & name, KomiX::model::archive::CompressedDevice::Format & format) {
+    using KomiX::model::archive::CompressedDevice;
+    if (name.endsWith("tar.gz") || name.endsWith("tgz")) {
+        format = CompressedDevice::Gzip;
+    } else if (name.endsWith("tar.bz2") || name.endsWith("tbz2")) {
+        format = CompressedDevice::Bzip2;
+    } else if (name.endsWith("tar.lzma") || name.endsWith("tar.xz") || name.endsWith("txz")) {
+        format = CompressedDevice::Xz;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/// link every volume of @p root beside @p archivePath, named as 7-Zip expects
+void linkVolumes(const QFileInfo & root, const QString & archivePath) {
+    QFileInfo link(archivePath);
+    foreach (QString volume, KomiX::model::archive::listVolumes(root)) {
+        QFileInfo fi(volume);
+        QFile::link(fi.absoluteFilePath(), link.dir().absoluteFilePath(QString("%1.%2").arg(link.baseName()).arg(fi.completeSuffix())));
+    }
+}
+
 std::shared_ptr<KomiX::model::FileModel> create(const QUrl & url) {
-    if (!KomiX::model::archive::ArchiveModel::IsRunnable()) {
+    QFileInfo fi(url.toLocalFile());
+    if (KomiX::model::archive::ZipModel::IsSupported(fi.fileName().toLower())) {
+        try {
+            return std::shared_ptr<KomiX::model::FileModel>(new KomiX::model::archive::ZipModel(fi));
+        } catch (KomiX::exception::ArchiveException & e) {
+            // fallback to 7-Zip
+            qDebug() << e.getMessage();
+        }
+    }
+    KomiX::model::archive::CompressedDevice::Format format;
+    bool runnable = isCompressedTar(fi.fileName().toLower(), format) || KomiX::model::archive::ArchiveModel::IsRunnable();
+    if (runnable && KomiX::model::archive::ArchiveModel::IsPrepared()) {
+        return std::shared_ptr<KomiX::model::FileModel>(new KomiX::model::archive::ArchiveModel(fi));
+    }
+#ifdef KOMIX_HAVE_LIBARCHIVE
+    if (KomiX::model::archive::LibArchiveModel::IsSupported(fi.fileName().toLower())) {
+        // without 7-Zip, solid blocks are decoded again for pages far behind
+        return std::shared_ptr<KomiX::model::FileModel>(new KomiX::model::archive::LibArchiveModel(fi));
+    }
+#endif
+    if (!runnable) {
         throw KomiX::exception::ArchiveException("This feature is based on 7-zip. Please install it.");
-    } else if (!KomiX::model::archive::ArchiveModel::IsPrepared()) {
-        throw KomiX::exception::ArchiveException("I could not create temporary directory.");
     }
-    return std::shared_ptr<KomiX::model::FileModel>(new KomiX::model::archive::ArchiveModel(QFileInfo(url.toLocalFile())));
+    throw KomiX::exception::ArchiveException("I could not create temporary directory.");
 }
 
 static const bool registered = KomiX::model::FileModel::registerModel(check, create);
@@ -76,7 +117,9 @@ inline const QStringList & archiveList2() {
                                           << "tgz"
                                           << "tar.bz2"
                                           << "tbz2"
-                                          << "tar.lzma";
+                                          << "tar.lzma"
+                                          << "tar.xz"
+                                          << "txz";
     return a2;
 }
 
@@ -94,7 +137,12 @@ inline QStringList archiveList() {
     a << "7z";
     a << "rar";
     a << "zip";
+    a << "cbz";
     a << "tar";
+    // first volumes of split sets, 7-Zip finds the others
+    a << "7z.001";
+    a << "zip.001";
+    a << "cbz.001";
     return a;
 }
 
@@ -119,21 +167,112 @@ inline const QString & sevenZip() {
 }
 
 QDir archiveDir(const QString & dirName) {
-    if (!KomiX::model::archive::getTmpDir().exists(dirName)) {
-        KomiX::model::archive::getTmpDir().mkdir(dirName);
-    }
-    QDir tmp(KomiX::model::archive::getTmpDir());
-    tmp.cd(dirName);
-    return tmp;
+    return KomiX::model::archive::ExtractionCache::instance().getDirectory(dirName);
 }
 
 QStringList arguments(const QString & fileName) {
     QStringList args("e");
     args << QString("-o%1").arg(archiveDir(fileName).absolutePath());
     args << "-aos";
+    // report each file on stdout
+    args << "-bb1";
+    return args;
+}
+
+// extract with full paths, so entries with same name in different
+// folders will not overwrite each other
+QStringList entryArguments(const QString & fileName, const QString & aFilePath) {
+    QStringList args("x");
+    args << QString("-o%1").arg(archiveDir(fileName).absolutePath());
+    // a file left on disk is a partial one, the journal tells
+    args << "-aoa";
+    // entry names are not wildcards
+    args << "-spd";
+    // report each file on stdout
+    args << "-bb1";
+    args << "--";
+    args << aFilePath;
     return args;
 }
 
+/// count of entries extracted ahead of the requested one
+const int PREFETCH_SIZE = 4;
+
+/// same order as QDir::Name | QDir::IgnoreCase
+bool entryLessThan(const KomiX::model::archive::Entry & l, const KomiX::model::archive::Entry & r) {
+    return QString::compare(l.name, r.name, Qt::CaseInsensitive) < 0;
+}
+
+std::vector<KomiX::model::archive::Entry> parseListing(const QString & output) {
+    std::vector<KomiX::model::archive::Entry> entries;
+    // technical information of entries begins after the separator
+    int begin = output.indexOf("\n----------");
+    if (begin < 0) {
+        return entries;
+    }
+
+    // solid archives report it before the entries
+    bool solid = output.left(begin).contains("\nSolid = +");
+    KomiX::model::archive::Entry entry;
+    bool folder = false;
+    QStringList lines = output.mid(begin + 11).split('\n');
+    // make sure the last entry is committed
+    lines << QString();
+    foreach (QString line, lines) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line.isEmpty()) {
+            if (!entry.name.isEmpty() && !folder) {
+                entries.push_back(entry);
+            }
+            entry = KomiX::model::archive::Entry();
+            folder = false;
+            continue;
+        }
+        int sep = line.indexOf(" = ");
+        if (sep < 0) {
+            continue;
+        }
+        QString key = line.left(sep);
+        QString value = line.mid(sep + 3);
+        if (key == "Path") {
+            entry.name = QDir::fromNativeSeparators(value);
+        } else if (key == "Size") {
+            entry.size = value.toLongLong();
+        } else if (key == "Packed Size") {
+            entry.packedSize = value.toLongLong();
+        } else if (key == "CRC") {
+            entry.crc32 = value.toUInt(nullptr, 16);
+        } else if (key == "Folder") {
+            folder = folder || value == "+";
+        } else if (key == "Attributes") {
+            folder = folder || value.startsWith('D');
+        } else if (key == "Block") {
+            entry.block = value.toInt();
+        }
+    }
+    if (!solid) {
+        // every entry can be decoded alone
+        for (size_t i = 0; i < entries.size(); ++i) {
+            entries[i].block = static_cast<qint32>(i);
+        }
+    }
+    return entries;
+}
+
+/// true if some solid block holds more than one of @p entries
+bool isSolid(const std::vector<KomiX::model::archive::Entry> & entries) {
+    QSet<qint32> blocks;
+    for (const KomiX::model::archive::Entry & entry : entries) {
+        if (blocks.contains(entry.block)) {
+            return true;
+        }
+        blocks.insert(entry.block);
+    }
+    return false;
+}
+
 } // end of namespace
 
 using KomiX::model::archive::ArchiveModel;
@@ -142,22 +281,50 @@ ArchiveModel::Private::Private(ArchiveModel * owner, const QFileInfo & root)
     : QObject()
     , owner(owner)
     , root(root)
-    , hash() {
+    , hash()
+    , archivePath()
+    , streaming(true)
+    , solid(false)
+    , listed(false)
+    , extracting()
+    , tarball()
+    , published(false)
+    , entries()
+    , pending()
+    , journaled()
+    , jobs()
+    , current()
+    , waiting()
+    , canceled(new QAtomicInt(0))
+    , seekIndex() {
+}
+
+ArchiveModel::Private::~Private() {
+    // stop unpacking, the worker holds its own reference
+    this->canceled->store(1);
+    ExtractionScheduler::instance().cancel(this);
+    // killed jobs report nothing to a dead model
+    this->abandonWaiting();
+    if (!this->hash.isEmpty()) {
+        MemoryStore::instance().release(ExtractionCache::instance().getRoot().filePath(this->hash));
+        ExtractionCache::instance().release(this->hash);
+    }
 }
 
 void ArchiveModel::Private::extract(const QString & aFilePath, const char * onFinished) {
     QProcess * p = new QProcess;
     this->connect(p, SIGNAL(finished(int)), onFinished);
     this->connect(p, SIGNAL(finished(int)), SLOT(cleanup(int)));
+    this->connect(p, SIGNAL(readyReadStandardOutput()), SLOT(onProgress()));
+    this->extracting.clear();
     qDebug() << (arguments(this->hash) << aFilePath);
-    p->start(sevenZip(), (arguments(this->hash) << aFilePath), QIODevice::ReadOnly);
+    ExtractionScheduler::instance().start(p, sevenZip(), (arguments(this->hash) << aFilePath), ExtractionScheduler::Background, this);
 }
 
 void ArchiveModel::Private::cleanup(int exitCode) {
     QProcess * p = static_cast<QProcess *>(this->sender());
     if (exitCode != 0) {
-        // delete wrong dir
-        KomiX::model::archive::delTree(archiveDir(hash));
+        // keep journaled pages, the others are discarded on reopen
         QString err = QString::fromLocal8Bit(p->readAllStandardError());
         qWarning() << p->readAllStandardOutput();
         qWarning() << err;
@@ -168,24 +335,459 @@ void ArchiveModel::Private::cleanup(int exitCode) {
 
 void ArchiveModel::Private::checkTwo(int exitCode) {
     if (exitCode != 0) {
+        // pages published so far are all there is
+        emit this->finished();
         return;
     }
     // check if is tar-compressed
     if (isTwo(this->root.fileName())) {
-        QString name = archiveDir(this->hash).absoluteFilePath(this->root.completeBaseName());
-        this->extract(name, SLOT(allDone(int)));
+        // 7-Zip names the tarball, "tgz" does not end with it
+        QString name = this->extracting.isEmpty() ? this->root.completeBaseName() : this->extracting;
+        this->tarball = archiveDir(this->hash).absoluteFilePath(name);
+        this->extract(this->tarball, SLOT(allDone(int)));
     } else {
-        this->owner->setRoot(archiveDir(this->hash));
-        emit this->ready();
+        this->allDone(exitCode);
     }
 }
 
 void ArchiveModel::Private::allDone(int exitCode) {
+    if (!this->tarball.isEmpty()) {
+        // pages are on disk, the tarball only takes cache space
+        QFile::remove(this->tarball);
+        this->tarball.clear();
+    }
+    if (exitCode != 0) {
+        emit this->finished();
+        return;
+    }
+    // the last reported file is complete now
+    this->journal(QStringList(this->extracting));
+    this->publish(QStringList(this->extracting));
+    this->extracting.clear();
+    // every page was reported, rows and the journal need no directory scan
+    QStringList files;
+    for (const Entry & entry : this->entries) {
+        files << entry.name;
+    }
+    ContentStore::instance().adoptLater(archiveDir(this->hash), files);
+    // reopened from the cache next time
+    saveTableOfContents(this->hash, "tar", this->entries);
+    markExtractionComplete(this->hash);
+    if (!this->published) {
+        // nothing readable, still tell the controller
+        this->published = true;
+        emit this->ready();
+    }
+    emit this->finished();
+}
+
+void ArchiveModel::Private::onProgress() {
+    QProcess * p = static_cast<QProcess *>(this->sender());
+    QStringList done;
+    while (p->canReadLine()) {
+        QString line = QString::fromLocal8Bit(p->readLine());
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (!line.startsWith("- ")) {
+            continue;
+        }
+        // 7-Zip reports a file before writing it, so the previous one is complete
+        if (!this->extracting.isEmpty()) {
+            done << this->extracting;
+        }
+        this->extracting = QFileInfo(QDir::fromNativeSeparators(line.mid(2))).fileName();
+    }
+    this->journal(done);
+    this->publish(done);
+}
+
+void ArchiveModel::Private::publish(const QStringList & files) {
+    std::vector<Entry> images;
+    foreach (QString file, files) {
+        if (SupportedFormats().contains(QFileInfo(file).suffix().toLower())) {
+            Entry entry;
+            entry.name = file;
+            images.push_back(entry);
+        }
+    }
+    this->insertEntries(images);
+}
+
+void ArchiveModel::Private::insertEntries(const std::vector<Entry> & incoming) {
+    std::vector<Entry> fresh;
+    for (const Entry & entry : incoming) {
+        auto it = std::lower_bound(this->entries.begin(), this->entries.end(), entry, entryLessThan);
+        if (it != this->entries.end() && it->name == entry.name) {
+            continue;
+        }
+        if (std::none_of(fresh.begin(), fresh.end(), [&entry](const Entry & e) -> bool {
+                return e.name == entry.name;
+            })) {
+            fresh.push_back(entry);
+        }
+    }
+    if (fresh.empty()) {
+        return;
+    }
+    std::sort(fresh.begin(), fresh.end(), entryLessThan);
+
+    int size = static_cast<int>(this->entries.size());
+    if (this->entries.empty() || entryLessThan(this->entries.back(), fresh.front())) {
+        // common case, append as one batch
+        this->owner->beginInsertRows(QModelIndex(), size, size + static_cast<int>(fresh.size()) - 1);
+        this->entries.insert(this->entries.end(), fresh.begin(), fresh.end());
+        this->owner->endInsertRows();
+    } else {
+        for (const Entry & entry : fresh) {
+            auto it = std::lower_bound(this->entries.begin(), this->entries.end(), entry, entryLessThan);
+            int row = static_cast<int>(it - this->entries.begin());
+            this->owner->beginInsertRows(QModelIndex(), row, row);
+            this->entries.insert(it, entry);
+            this->owner->endInsertRows();
+        }
+    }
+    if (!this->published) {
+        // the first page is readable
+        this->published = true;
+        emit this->ready();
+    }
+}
+
+void ArchiveModel::Private::unpack(CompressedDevice::Format format) {
+    TarExtractor * worker =
+        new TarExtractor(this->root.absoluteFilePath(), format, this->hash, SupportedFormats(), this->canceled, this->seekIndex, this->journaled);
+    this->connect(worker, SIGNAL(extracted(const QString &)), SLOT(onUnpacked(const QString &)));
+    this->connect(worker, SIGNAL(indexed(const QString &, qint64, qint64)), SLOT(onIndexed(const QString &, qint64, qint64)));
+    this->connect(worker, SIGNAL(finished(bool, const QString &)), SLOT(onUnpackFinished(bool, const QString &)));
+    ExtractionScheduler::instance().start(worker, ExtractionScheduler::Background, this);
+}
+
+void ArchiveModel::Private::onUnpacked(const QString & name) {
+    if (archiveDir(this->hash).exists(name)) {
+        // pages in memory are gone with this session
+        this->journal(QStringList(name));
+    }
+    this->publish(QStringList(name));
+}
+
+void ArchiveModel::Private::onIndexed(const QString & name, qint64 offset, qint64 size) {
+    Entry entry;
+    entry.name = name;
+    entry.offset = offset;
+    entry.size = size;
+    this->insertEntries(std::vector<Entry>(1, entry));
+}
+
+void ArchiveModel::Private::onUnpackFinished(bool ok, const QString & message) {
+    if (ok) {
+        markExtractionComplete(this->hash);
+        if (!this->published) {
+            // nothing readable, still tell the controller
+            this->published = true;
+            emit this->ready();
+        }
+        emit this->finished();
+        return;
+    }
+    qWarning() << message;
+    if (this->published || !ArchiveModel::IsRunnable()) {
+        emit this->error(message);
+        emit this->finished();
+        return;
+    }
+    // let 7-Zip try, it knows more variants
+    this->seekIndex.reset();
+    QFile::link(this->root.absoluteFilePath(), this->archivePath);
+    this->extract(this->archivePath, SLOT(checkTwo(int)));
+}
+
+void ArchiveModel::Private::list() {
+    QProcess * p = new QProcess;
+    this->connect(p, SIGNAL(finished(int)), SLOT(onListed(int)));
+    // no page can be shown before the listing
+    ExtractionScheduler::instance().start(p, sevenZip(), QStringList() << "l"
+                                                                       << "-slt"
+                                                                       << "--" << this->archivePath,
+                                          ExtractionScheduler::Foreground, this);
+}
+
+void ArchiveModel::Private::onListed(int exitCode) {
+    QProcess * p = static_cast<QProcess *>(this->sender());
+    p->deleteLater();
     if (exitCode != 0) {
+        QString err = QString::fromLocal8Bit(p->readAllStandardError());
+        qWarning() << err;
+        emit this->error(err);
         return;
     }
-    this->owner->setRoot(archiveDir(this->hash));
+
+    std::vector<Entry> images;
+    foreach (const Entry & entry, parseListing(QString::fromLocal8Bit(p->readAllStandardOutput()))) {
+        if (SupportedFormats().contains(QFileInfo(entry.name).suffix().toLower())) {
+            images.push_back(entry);
+        }
+    }
+    std::sort(images.begin(), images.end(), entryLessThan);
+    saveTableOfContents(this->hash, "7z", images);
+    this->solid = isSolid(images);
+    this->setEntries(images);
+}
+
+void ArchiveModel::Private::setEntries(const std::vector<Entry> & entries) {
+    this->owner->beginResetModel();
+    this->entries = entries;
+    this->owner->endResetModel();
+    this->published = true;
     emit this->ready();
+    emit this->finished();
+}
+
+QIODevice * ArchiveModel::Private::open(int row) {
+    if (this->seekIndex) {
+        return this->seek(row);
+    }
+    const Entry & entry = this->entries[row];
+    const QString & name = entry.name;
+    QDir dir = archiveDir(this->hash);
+    if (!this->listed) {
+        // extracted as a whole, in memory or on disk
+        return LocalFileModel::OpenFile(dir.filePath(name));
+    }
+    bool extracted = this->isExtracted(entry);
+    // piping one entry of a solid block decodes the block up to it, every time
+    if (this->streaming && !this->solid) {
+        return extracted ? LocalFileModel::OpenFile(dir.filePath(name)) : this->stream(name);
+    }
+    if (!extracted && !this->pending.contains(name)) {
+        if (this->solid) {
+            // one pass over its block, pages are delivered as they are decoded
+            this->extractBlock(entry.block, ExtractionScheduler::Foreground);
+        } else {
+            // the requested one goes first, alone
+            this->extractEntries(QStringList(name), ExtractionScheduler::Foreground);
+        }
+    } else if (!extracted) {
+        // was prefetched, but may still be waiting for its turn
+        for (auto it = this->jobs.begin(); it != this->jobs.end(); ++it) {
+            if (it.value().contains(name)) {
+                ExtractionScheduler::instance().hurry(static_cast<QProcess *>(it.key()));
+                break;
+            }
+        }
+    }
+    this->prefetch(row + 1);
+    if (extracted) {
+        return LocalFileModel::OpenFile(dir.filePath(name));
+    }
+
+    DeferredFile * device = new DeferredFile(dir.filePath(name));
+    this->waiting.insert(name, device);
+    return device;
+}
+
+QIODevice * ArchiveModel::Private::stream(const QString & name) {
+    // the pipe goes to CharacterDeviceLoader, nothing touches the disk
+    QProcess * p = new QProcess;
+    // owned by the loader, outlives the model
+    ExtractionScheduler::instance().start(p, sevenZip(), QStringList() << "x"
+                                                                       << "-so"
+                                                                       << "-spd"
+                                                                       << "--" << this->archivePath << name,
+                                          ExtractionScheduler::Foreground, nullptr);
+    return p;
+}
+
+QIODevice * ArchiveModel::Private::seek(int row) {
+    // inflates at most one span before the page, on a worker
+    const Entry & entry = this->entries[row];
+    DeferredFile * device = new DeferredFile(QString());
+    GzipReader * reader = new GzipReader(this->seekIndex, this->root.absoluteFilePath(), entry.offset, entry.size);
+    device->connect(reader, SIGNAL(finished(const QByteArray &)), SLOT(complete(const QByteArray &)));
+    // owned by the loader, outlives the model
+    ExtractionScheduler::instance().start(reader, ExtractionScheduler::Foreground, nullptr);
+    return device;
+}
+
+void ArchiveModel::Private::prefetch(int row) {
+    int end = std::min(row + PREFETCH_SIZE, static_cast<int>(this->entries.size()));
+    if (this->solid) {
+        // blocks are queued in reading order, each decoded once
+        for (int i = row; i < end; ++i) {
+            this->extractBlock(this->entries[i].block, ExtractionScheduler::Background);
+        }
+        return;
+    }
+    QStringList names;
+    for (int i = row; i < end; ++i) {
+        const Entry & entry = this->entries[i];
+        if (!this->pending.contains(entry.name) && !this->isExtracted(entry)) {
+            names << entry.name;
+        }
+    }
+    if (!names.isEmpty()) {
+        this->extractEntries(names, ExtractionScheduler::Background);
+    }
+}
+
+void ArchiveModel::Private::extractEntries(const QStringList & names, ExtractionScheduler::Lane lane) {
+    QProcess * p = new QProcess;
+    this->connect(p, SIGNAL(readyReadStandardOutput()), SLOT(onEntryProgress()));
+    this->connect(p, SIGNAL(finished(int)), SLOT(onEntriesExtracted(int)));
+    this->connect(p, SIGNAL(error(QProcess::ProcessError)), SLOT(onEntriesFailed(QProcess::ProcessError)));
+    foreach (QString name, names) {
+        this->pending.insert(name);
+    }
+    this->jobs.insert(p, names);
+    ExtractionScheduler::instance().start(p, sevenZip(), entryArguments(this->hash, this->archivePath) << names, lane, this);
+}
+
+void ArchiveModel::Private::extractBlock(qint32 block, ExtractionScheduler::Lane lane) {
+    QStringList names;
+    for (const Entry & entry : this->entries) {
+        if (entry.block != block) {
+            continue;
+        }
+        if (!this->pending.contains(entry.name) && !this->isExtracted(entry)) {
+            names << entry.name;
+        }
+    }
+    if (!names.isEmpty()) {
+        this->extractEntries(names, lane);
+    }
+}
+
+bool ArchiveModel::Private::isExtracted(const Entry & entry) {
+    if (this->pending.contains(entry.name)) {
+        return false;
+    }
+    QDir dir = archiveDir(this->hash);
+    return this->journaled.contains(entry.name) && dir.exists(entry.name);
+}
+
+void ArchiveModel::Private::journal(const QStringList & names) {
+    QStringList fresh;
+    foreach (QString name, names) {
+        if (!name.isEmpty() && !this->journaled.contains(name)) {
+            this->journaled.insert(name);
+            fresh << name;
+        }
+    }
+    if (fresh.isEmpty()) {
+        return;
+    }
+    appendJournal(this->hash, fresh);
+    if (!this->listed) {
+        // the full extraction marks itself when it ends
+        return;
+    }
+    for (const Entry & entry : this->entries) {
+        if (!this->journaled.contains(entry.name)) {
+            return;
+        }
+    }
+    markExtractionComplete(this->hash);
+}
+
+void ArchiveModel::Private::discardPartial() {
+    // left by a session which was cut short, maybe half written
+    QDir dir = archiveDir(this->hash);
+    QDirIterator it(dir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString name = dir.relativeFilePath(it.next());
+        if (!name.startsWith('.') && !this->journaled.contains(name)) {
+            QFile::remove(dir.filePath(name));
+        }
+    }
+}
+
+void ArchiveModel::Private::finishEntry(const QString & name, bool ok) {
+    this->pending.remove(name);
+    foreach (QPointer<DeferredFile> device, this->waiting.values(name)) {
+        if (device) {
+            device->complete(ok);
+        }
+    }
+    this->waiting.remove(name);
+}
+
+void ArchiveModel::Private::abandonWaiting() {
+    // loaders block until their device is complete
+    foreach (QPointer<DeferredFile> device, this->waiting) {
+        if (device) {
+            device->complete(false);
+        }
+    }
+    this->waiting.clear();
+    this->pending.clear();
+    this->jobs.clear();
+    this->current.clear();
+}
+
+void ArchiveModel::Private::onEntriesFailed(QProcess::ProcessError error) {
+    // no finished signal in this case
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+    QProcess * p = static_cast<QProcess *>(this->sender());
+    p->deleteLater();
+    this->current.remove(p);
+    foreach (QString name, this->jobs.take(p)) {
+        this->finishEntry(name, false);
+    }
+    QString err = p->errorString();
+    qWarning() << err;
+    emit this->error(err);
+}
+
+void ArchiveModel::Private::onEntryProgress() {
+    QProcess * p = static_cast<QProcess *>(this->sender());
+    if (!this->jobs.contains(p)) {
+        return;
+    }
+    QDir dir = archiveDir(this->hash);
+    QStringList & names = this->jobs[p];
+    QStringList done;
+    while (p->canReadLine()) {
+        QString line = QString::fromLocal8Bit(p->readLine()).trimmed();
+        if (!line.startsWith("- ")) {
+            continue;
+        }
+        // 7-Zip names a file before writing it, so the previous one is complete
+        QString previous = this->current.value(p);
+        if (!previous.isEmpty() && names.removeOne(previous)) {
+            bool ok = dir.exists(previous);
+            if (ok) {
+                done << previous;
+            }
+            this->finishEntry(previous, ok);
+        }
+        this->current.insert(p, QDir::fromNativeSeparators(line.mid(2)));
+    }
+    this->journal(done);
+    ContentStore::instance().adoptLater(dir, done);
+}
+
+void ArchiveModel::Private::onEntriesExtracted(int exitCode) {
+    QProcess * p = static_cast<QProcess *>(this->sender());
+    p->deleteLater();
+    this->current.remove(p);
+    QDir dir = archiveDir(this->hash);
+    QStringList done;
+    foreach (QString name, this->jobs.take(p)) {
+        bool ok = exitCode == 0 && dir.exists(name);
+        if (ok) {
+            done << name;
+        }
+        this->finishEntry(name, ok);
+    }
+    this->journal(done);
+    ContentStore::instance().adoptLater(dir, done);
+    if (exitCode != 0) {
+        QString err = QString::fromLocal8Bit(p->readAllStandardError());
+        qWarning() << err;
+        emit this->error(err);
+    }
 }
 
 bool ArchiveModel::IsRunnable() {
@@ -193,32 +795,134 @@ bool ArchiveModel::IsRunnable() {
 }
 
 bool ArchiveModel::IsPrepared() {
-    return QDir::temp() != getTmpDir();
+    return QDir::temp() != getTmpDir() && ExtractionCache::instance().isPrepared();
 }
 
 ArchiveModel::ArchiveModel(const QFileInfo & root)
-    : LocalFileModel()
+    : FileModel()
     , p_(new Private(this, root)) {
     this->connect(this->p_.get(), SIGNAL(error(const QString &)), SIGNAL(error(const QString &)));
     this->connect(this->p_.get(), SIGNAL(ready()), SIGNAL(ready()));
+    this->connect(this->p_.get(), SIGNAL(finished()), SIGNAL(finished()));
+}
+
+QModelIndex ArchiveModel::index(const QUrl & url) const {
+    QString name = QFileInfo(url.toLocalFile()).fileName();
+    for (int row = 0; row < this->rowCount(); ++row) {
+        if (QFileInfo(this->p_->entries[row].name).fileName() == name) {
+            return createIndex(row, 0, row);
+        }
+    }
+    return QModelIndex();
+}
+
+QModelIndex ArchiveModel::index(int row, int column, const QModelIndex & parent) const {
+    if (!parent.isValid()) {
+        // query from root
+        if (column == 0 && row >= 0 && row < this->rowCount()) {
+            return createIndex(row, 0, row);
+        } else {
+            return QModelIndex();
+        }
+    } else {
+        // other node has no child
+        return QModelIndex();
+    }
+}
+
+QModelIndex ArchiveModel::parent(const QModelIndex & /*child*/) const {
+    // flat list, every node is a child of root
+    return QModelIndex();
+}
+
+int ArchiveModel::rowCount(const QModelIndex & parent) const {
+    if (!parent.isValid()) {
+        // root row size
+        return this->p_->entries.size();
+    } else {
+        // others are leaf
+        return 0;
+    }
+}
+
+int ArchiveModel::columnCount(const QModelIndex & /*parent*/) const {
+    return 1;
+}
+
+QVariant ArchiveModel::data(const QModelIndex & index, int role) const {
+    if (!index.isValid() || index.column() != 0 || index.row() < 0 || index.row() >= this->rowCount()) {
+        return QVariant();
+    }
+    switch (role) {
+        case Qt::DisplayRole:
+            return this->p_->entries[index.row()].name;
+        case Qt::UserRole:
+            return QVariant::fromValue(this->p_->open(index.row()));
+        default:
+            return QVariant();
+    }
 }
 
 void ArchiveModel::doInitialize() {
-    this->p_->hash = QString::fromUtf8(QCryptographicHash::hash(this->p_->root.fileName().toUtf8(), QCryptographicHash::Sha1).toHex());
+    this->p_->hash = getArchiveKey(this->p_->root);
+    ExtractionCache::instance().acquire(this->p_->hash);
+
+    auto origPath = this->p_->root.absoluteFilePath();
+    auto ext = this->p_->root.completeSuffix();
+    this->p_->archivePath = getTmpDir().absoluteFilePath(QString("%1.%2").arg(this->p_->hash).arg(ext));
+
+    if (!isTwo(this->p_->root.fileName())) {
+        // list now, extract or stream entries on demand
+        this->p_->streaming = QSettings().value("stream_archive", false).toBool();
+        this->p_->listed = true;
+        this->p_->journaled = loadJournal(this->p_->hash);
+        linkVolumes(this->p_->root, this->p_->archivePath);
+        std::vector<Entry> entries;
+        if (loadTableOfContents(this->p_->hash, "7z", entries)) {
+            // listed before, no need to run 7-Zip
+            this->p_->solid = isSolid(entries);
+            this->p_->setEntries(entries);
+        } else {
+            this->p_->list();
+        }
+        return;
+    }
 
-    if (getTmpDir().exists(this->p_->hash)) {
+    std::vector<Entry> entries;
+    if (isExtractionComplete(this->p_->hash) && loadTableOfContents(this->p_->hash, "tar", entries)) {
         // uncompressed before
-        this->setRoot(archiveDir(this->p_->hash));
-        emit this->ready();
+        std::sort(entries.begin(), entries.end(), entryLessThan);
+        this->p_->setEntries(entries);
         return;
     }
 
-    auto origPath = this->p_->root.absoluteFilePath();
-    auto ext = this->p_->root.completeSuffix();
-    auto linkPath = getTmpDir().absoluteFilePath(QString("%1.%2").arg(this->p_->hash).arg(ext));
-    QFile::link(origPath, linkPath);
+    CompressedDevice::Format format;
+    bool compressed = isCompressedTar(this->p_->root.fileName().toLower(), format);
+    if (compressed && format == CompressedDevice::Gzip && QSettings().value("seek_gzip", true).toBool()) {
+        // pages are read from the tarball through access points, nothing is written but the index
+        this->p_->seekIndex.reset(new GzipIndex);
+        if (loadTableOfContents(this->p_->hash, "gzip", entries) && this->p_->seekIndex->load(this->p_->hash)) {
+            std::sort(entries.begin(), entries.end(), entryLessThan);
+            this->p_->setEntries(entries);
+            return;
+        }
+    }
+
+    // resume, only missing pages are written
+    this->p_->journaled = loadJournal(this->p_->hash);
+    this->p_->discardPartial();
+    if (!this->p_->seekIndex) {
+        this->p_->publish(this->p_->journaled.toList());
+    }
 
-    this->p_->extract(linkPath, SLOT(checkTwo(int)));
+    // rows are published while extracting
+    if (compressed) {
+        // one pass, the tarball is never written
+        this->p_->unpack(format);
+        return;
+    }
+    QFile::link(origPath, this->p_->archivePath);
+    this->p_->extract(this->p_->archivePath, SLOT(checkTwo(int)));
 }
 
 namespace KomiX {
@@ -236,6 +940,10 @@ const QStringList & ArchiveFormatsFilter() {
 }
 
 bool isArchiveSupported(const QString & name) {
+    if (isTrailingVolume(name)) {
+        // opened with the first one
+        return false;
+    }
     foreach (QString ext, ArchiveFormats()) {
         if (name.endsWith(ext)) {
             return true;
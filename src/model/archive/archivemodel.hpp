@@ -21,7 +21,9 @@
 #ifndef KOMIX_MODEL_ARCHIVE_ARCHIVEMODEL_HPP
 #define KOMIX_MODEL_ARCHIVE_ARCHIVEMODEL_HPP
 
-#include "localfilemodel.hpp"
+#include "filemodel.hpp"
+
+#include <QtCore/QFileInfo>
 
 namespace KomiX {
 namespace model {
@@ -30,10 +32,21 @@ namespace archive {
 /**
  * @brief The model using 7-Zip to open compressed file
  *
- * Supported file formats: 7z, zip, rar, tar.gz, tar.bz2.
+ * The archive is listed first, then entries are extracted to disk
+ * along with a few following ones when they are requested. If streaming
+ * is enabled in settings, entries are piped from 7-Zip instead.
+ * Tar-compressed files are extracted all at once.
+ * Rows are archive entries rather than files in the cache directory, so
+ * pages are listed without scanning it, and each one is read from the
+ * memory store, the gzip index or the extracted file.
+ * Extracted pages are journaled, so an extraction cut short by a crash
+ * resumes with the missing pages instead of showing half written ones.
+ *
+ * Supported file formats: 7z, zip, rar, tar.gz, tar.bz2, and split
+ * sets of them (.7z.001, .partN.rar), which are opened by the first volume.
  * Do not support password.
  */
-class ArchiveModel : public LocalFileModel {
+class ArchiveModel : public FileModel {
 public:
     /// Check if 7-zip existed
     static bool IsRunnable();
@@ -46,6 +59,20 @@ public:
      */
     ArchiveModel(const QFileInfo & root);
 
+    /// Overrides from FileModel
+    virtual QModelIndex index(const QUrl & url) const;
+
+    /// Overrides from FileModel
+    virtual QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual QModelIndex parent(const QModelIndex & child) const;
+    /// Overrides from FileModel
+    virtual int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual int columnCount(const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel, extract the entry if necessary
+    virtual QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
 protected:
     virtual void doInitialize();
 
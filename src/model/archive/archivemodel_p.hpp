@@ -22,6 +22,20 @@
 #define KOMIX_MODEL_ARCHIVE_ARCHIVEMODEL_HPP_
 
 #include "archivemodel.hpp"
+#include "compresseddevice.hpp"
+#include "deferredfile.hpp"
+#include "entry.hpp"
+#include "extractionscheduler.hpp"
+#include "gzipindex.hpp"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QPointer>
+#include <QtCore/QProcess>
+#include <QtCore/QSet>
+
+#include <memory>
+#include <vector>
 
 namespace KomiX {
 namespace model {
@@ -31,22 +45,67 @@ class ArchiveModel::Private : public QObject {
     Q_OBJECT
 public:
     explicit Private(ArchiveModel * owner, const QFileInfo & root);
+    virtual ~Private();
 
     void extract(const QString &, const char *);
+    void list();
+    void setEntries(const std::vector<Entry> & entries);
+    void insertEntries(const std::vector<Entry> & incoming);
+    QIODevice * open(int row);
+    QIODevice * stream(const QString & name);
+    QIODevice * seek(int row);
+    void prefetch(int row);
+    void extractEntries(const QStringList & names, ExtractionScheduler::Lane lane);
+    void extractBlock(qint32 block, ExtractionScheduler::Lane lane);
+    void finishEntry(const QString & name, bool ok);
+    void abandonWaiting();
+    bool isExtracted(const Entry & entry);
+    void journal(const QStringList & names);
+    void discardPartial();
+    void publish(const QStringList & files);
+    void unpack(CompressedDevice::Format format);
 
 public slots:
     void cleanup(int);
     void checkTwo(int);
     void allDone(int);
+    void onProgress();
+    void onListed(int);
+    void onEntryProgress();
+    void onEntriesExtracted(int);
+    void onEntriesFailed(QProcess::ProcessError);
+    void onUnpacked(const QString & name);
+    void onIndexed(const QString & name, qint64 offset, qint64 size);
+    void onUnpackFinished(bool ok, const QString & message);
 
 signals:
     void ready();
+    void finished();
     void error(const QString &);
 
 public:
     ArchiveModel * owner;
     QFileInfo root;
     QString hash;
+    QString archivePath;
+    bool streaming;
+    bool solid;
+    // rows come from the listing, entries are extracted on demand
+    bool listed;
+    QString extracting;
+    // written by the first pass over a compressed tarball
+    QString tarball;
+    bool published;
+    std::vector<Entry> entries;
+    QSet<QString> pending;
+    // completely written, see loadJournal()
+    QSet<QString> journaled;
+    QHash<QObject *, QStringList> jobs;
+    // the file each job is writing
+    QHash<QObject *, QString> current;
+    QMultiHash<QString, QPointer<DeferredFile>> waiting;
+    std::shared_ptr<QAtomicInt> canceled;
+    std::shared_ptr<GzipIndex> seekIndex;
 };
 }
 }
@@ -0,0 +1,499 @@
+/**
+ * @file bzip2blockreader.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "bzip2blockreader.hpp"
+
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include <bzlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+namespace {
+
+const quint64 BLOCK_MAGIC = Q_UINT64_C(0x314159265359);
+const quint64 END_MAGIC = Q_UINT64_C(0x177245385090);
+const quint64 MAGIC_MASK = Q_UINT64_C(0xFFFFFFFFFFFF);
+const quint64 STREAM_HEADER = Q_UINT64_C(0x425A6839);
+const qint64 CHUNK_SIZE = 1024 * 1024;
+/// a false magic never splits a block this many times
+const int MAX_MERGE = 4;
+
+/// big-endian bit packer, same bit order as bzip2
+class BitWriter {
+public:
+    BitWriter()
+        : data()
+        , buffer(0)
+        , count(0) {
+    }
+
+    void put(int bit) {
+        this->buffer = (this->buffer << 1) | bit;
+        if (++this->count == 8) {
+            this->data.append(static_cast<char>(this->buffer));
+            this->buffer = 0;
+            this->count = 0;
+        }
+    }
+
+    void write(quint64 value, int bits) {
+        for (int i = bits - 1; i >= 0; --i) {
+            this->put((value >> i) & 1);
+        }
+    }
+
+    /// append @p bits bits of @p source, begins at bit @p offset
+    void copy(const QByteArray & source, qint64 offset, qint64 bits) {
+        const unsigned char * p = reinterpret_cast<const unsigned char *>(source.constData());
+        if (this->count == 0) {
+            // byte aligned, shift whole bytes
+            int shift = offset % 8;
+            const unsigned char * q = p + offset / 8;
+            qint64 bytes = bits / 8;
+            int begin = this->data.size();
+            this->data.resize(begin + bytes);
+            char * out = this->data.data() + begin;
+            for (qint64 i = 0; i < bytes; ++i) {
+                out[i] = static_cast<char>(shift ? (q[i] << shift) | (q[i + 1] >> (8 - shift)) : q[i]);
+            }
+            offset += bytes * 8;
+            bits -= bytes * 8;
+        }
+        for (qint64 i = 0; i < bits; ++i) {
+            qint64 b = offset + i;
+            this->put((p[b / 8] >> (7 - b % 8)) & 1);
+        }
+    }
+
+    /// complete bytes written so far
+    const QByteArray & bytes() const {
+        return this->data;
+    }
+
+    QByteArray finish() {
+        if (this->count > 0) {
+            this->data.append(static_cast<char>(this->buffer << (8 - this->count)));
+            this->buffer = 0;
+            this->count = 0;
+        }
+        return this->data;
+    }
+
+private:
+    QByteArray data;
+    unsigned int buffer;
+    int count;
+};
+
+quint64 readBits(const QByteArray & source, qint64 offset, int bits) {
+    const unsigned char * p = reinterpret_cast<const unsigned char *>(source.constData());
+    quint64 value = 0;
+    for (int i = 0; i < bits; ++i) {
+        qint64 b = offset + i;
+        value = (value << 1) | ((p[b / 8] >> (7 - b % 8)) & 1);
+    }
+    return value;
+}
+
+/// bits of one block, from its magic to the next magic
+struct Block {
+    Block()
+        : payload()
+        , bits(0)
+        , trailer(false)
+        , output()
+        , ok(false)
+        , done(false) {
+    }
+
+    QByteArray payload;
+    qint64 bits;
+    /// begins with the end of stream magic, nothing to decompress
+    bool trailer;
+    QByteArray output;
+    bool ok;
+    bool done;
+};
+
+/// wrap @p block as a single block stream, then decompress
+bool decompress(const Block & block, QByteArray & output) {
+    BitWriter writer;
+    // the largest block size always fits
+    writer.write(STREAM_HEADER, 32);
+    writer.copy(block.payload, 0, block.bits);
+    writer.write(END_MAGIC, 48);
+    // combined CRC of a single block stream is the block CRC
+    writer.write(readBits(block.payload, 48, 32), 32);
+    QByteArray stream = writer.finish();
+
+    bz_stream bs;
+    std::memset(&bs, 0, sizeof(bs));
+    if (BZ2_bzDecompressInit(&bs, 0, 0) != BZ_OK) {
+        return false;
+    }
+    bs.next_in = stream.data();
+    bs.avail_in = stream.size();
+    output.resize(CHUNK_SIZE);
+    qint64 produced = 0;
+    int ret = BZ_OK;
+    for (;;) {
+        if (produced == output.size()) {
+            output.resize(output.size() * 2);
+        }
+        bs.next_out = output.data() + produced;
+        bs.avail_out = output.size() - produced;
+        ret = BZ2_bzDecompress(&bs);
+        produced = output.size() - bs.avail_out;
+        if (ret != BZ_OK || (bs.avail_in == 0 && bs.avail_out > 0)) {
+            break;
+        }
+    }
+    BZ2_bzDecompressEnd(&bs);
+    output.truncate(produced);
+    return ret == BZ_STREAM_END;
+}
+
+/// bzip2 stream which is always released
+class Decompressor {
+public:
+    Decompressor() {
+        std::memset(&this->bs, 0, sizeof(this->bs));
+        if (BZ2_bzDecompressInit(&this->bs, 0, 0) != BZ_OK) {
+            throw KomiX::exception::ArchiveException("can not initialize libbz2");
+        }
+    }
+    ~Decompressor() {
+        BZ2_bzDecompressEnd(&this->bs);
+    }
+
+    /// feed @p size bytes, false on broken data
+    bool feed(const char * data, qint64 size, QByteArray & output) {
+        this->bs.next_in = const_cast<char *>(data);
+        this->bs.avail_in = static_cast<unsigned int>(size);
+        qint64 produced = output.size();
+        do {
+            if (output.size() - produced < CHUNK_SIZE) {
+                output.resize(produced + CHUNK_SIZE);
+            }
+            this->bs.next_out = output.data() + produced;
+            this->bs.avail_out = output.size() - produced;
+            int ret = BZ2_bzDecompress(&this->bs);
+            produced = output.size() - this->bs.avail_out;
+            if (ret != BZ_OK) {
+                output.truncate(produced);
+                return false;
+            }
+        } while (this->bs.avail_in > 0 || this->bs.avail_out == 0);
+        output.truncate(produced);
+        return true;
+    }
+
+    bz_stream bs;
+};
+
+struct Sync {
+    QMutex lock;
+    QWaitCondition changed;
+};
+
+class BlockJob : public QRunnable {
+public:
+    BlockJob(std::shared_ptr<Block> block, std::shared_ptr<Sync> sync)
+        : QRunnable()
+        , block(block)
+        , sync(sync) {
+    }
+
+    virtual void run() {
+        QByteArray output;
+        bool ok = decompress(*this->block, output);
+        QMutexLocker locker(&this->sync->lock);
+        this->block->output = output;
+        this->block->ok = ok;
+        this->block->done = true;
+        this->sync->changed.wakeAll();
+    }
+
+private:
+    std::shared_ptr<Block> block;
+    std::shared_ptr<Sync> sync;
+};
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class Bzip2BlockReader::Private {
+public:
+    Private(QIODevice * source, int threads);
+    ~Private();
+
+    std::shared_ptr<Block> scan();
+    void fill();
+    bool advance();
+    std::shared_ptr<Block> recover(std::shared_ptr<Block> first);
+
+    QIODevice * source;
+    int threads;
+    QByteArray buffer;
+    // absolute bit offset of buffer
+    qint64 base;
+    // next candidate byte in buffer
+    int position;
+    // next bit alignment to check at position
+    int alignment;
+    // absolute bit offset of current block magic, -1 if none
+    qint64 blockStart;
+    // current block is a stream trailer
+    bool trailing;
+    bool started;
+    bool exhausted;
+    bool table[256];
+    std::deque<std::shared_ptr<Block>> queue;
+    QByteArray current;
+    int cursor;
+    std::shared_ptr<Sync> sync;
+    QThreadPool pool;
+};
+}
+}
+}
+
+using KomiX::model::archive::Bzip2BlockReader;
+using KomiX::exception::ArchiveException;
+
+Bzip2BlockReader::Private::Private(QIODevice * source, int threads)
+    : source(source)
+    , threads(threads)
+    , buffer()
+    , base(0)
+    , position(0)
+    , alignment(0)
+    , blockStart(-1)
+    , trailing(false)
+    , started(false)
+    , exhausted(false)
+    , table()
+    , queue()
+    , current()
+    , cursor(0)
+    , sync(new Sync)
+    , pool() {
+    // the second byte of a magic is fixed for each bit alignment
+    std::fill(this->table, this->table + 256, false);
+    for (int s = 0; s < 8; ++s) {
+        this->table[(BLOCK_MAGIC >> (32 + s)) & 0xFF] = true;
+        this->table[(END_MAGIC >> (32 + s)) & 0xFF] = true;
+    }
+    this->pool.setMaxThreadCount(threads);
+}
+
+Bzip2BlockReader::Private::~Private() {
+    this->pool.waitForDone();
+}
+
+std::shared_ptr<Block> Bzip2BlockReader::Private::scan() {
+    if (!this->started) {
+        QByteArray header = this->source->read(4);
+        if (header.size() != 4 || !header.startsWith("BZh")) {
+            throw ArchiveException("broken bzip2 stream");
+        }
+        this->started = true;
+        this->base = 32;
+    }
+
+    for (;;) {
+        const unsigned char * p = reinterpret_cast<const unsigned char *>(this->buffer.constData());
+        for (; this->position + 7 <= this->buffer.size(); ++this->position, this->alignment = 0) {
+            if (!this->table[p[this->position + 1]]) {
+                continue;
+            }
+            quint64 word = 0;
+            for (int i = 0; i < 7; ++i) {
+                word = (word << 8) | p[this->position + i];
+            }
+            for (int s = this->alignment; s < 8; ++s) {
+                quint64 magic = (word >> (8 - s)) & MAGIC_MASK;
+                if (magic != BLOCK_MAGIC && magic != END_MAGIC) {
+                    continue;
+                }
+                qint64 at = this->base + this->position * 8 + s;
+                std::shared_ptr<Block> block;
+                if (this->blockStart >= 0) {
+                    block.reset(new Block);
+                    BitWriter writer;
+                    block->bits = at - this->blockStart;
+                    block->trailer = this->trailing;
+                    writer.copy(this->buffer, this->blockStart - this->base, block->bits);
+                    block->payload = writer.finish();
+                }
+                // trailers are kept too, a false end magic must not lose
+                // the rest of its block
+                this->blockStart = at;
+                this->trailing = magic == END_MAGIC;
+                if (block) {
+                    // continue after this alignment next time
+                    this->alignment = s + 1;
+                    if (this->alignment == 8) {
+                        ++this->position;
+                        this->alignment = 0;
+                    }
+                    // drop consumed bytes
+                    int drop = std::min<qint64>((this->blockStart - this->base) / 8, this->position);
+                    this->buffer.remove(0, drop);
+                    this->base += drop * 8;
+                    this->position -= drop;
+                    return block;
+                }
+            }
+        }
+        if (this->exhausted) {
+            if (this->blockStart >= 0 && !this->trailing) {
+                throw ArchiveException("unexpected end of bzip2 stream");
+            }
+            return std::shared_ptr<Block>();
+        }
+        QByteArray chunk = this->source->read(CHUNK_SIZE);
+        if (chunk.isEmpty()) {
+            this->exhausted = true;
+        }
+        if (this->blockStart < 0) {
+            // nothing to keep before the scanning position
+            this->buffer.remove(0, this->position);
+            this->base += this->position * 8;
+            this->position = 0;
+        }
+        this->buffer.append(chunk);
+    }
+}
+
+void Bzip2BlockReader::Private::fill() {
+    while (static_cast<int>(this->queue.size()) < this->threads * 2) {
+        std::shared_ptr<Block> block = this->scan();
+        if (!block) {
+            return;
+        }
+        this->queue.push_back(block);
+        if (block->trailer) {
+            block->ok = true;
+            block->done = true;
+            continue;
+        }
+        this->pool.start(new BlockJob(block, this->sync));
+    }
+}
+
+bool Bzip2BlockReader::Private::advance() {
+    this->fill();
+    if (this->queue.empty()) {
+        return false;
+    }
+    std::shared_ptr<Block> block = this->queue.front();
+    this->queue.pop_front();
+    {
+        QMutexLocker locker(&this->sync->lock);
+        while (!block->done) {
+            this->sync->changed.wait(&this->sync->lock);
+        }
+    }
+
+    if (!block->ok) {
+        // a false magic split the block
+        block = this->recover(block);
+    }
+    this->current = block->output;
+    this->cursor = 0;
+    return true;
+}
+
+/**
+ * Decodes @p first and the blocks following it with one sequential
+ * decoder, which finds the real end of the block by itself. The block can
+ * only end at a magic, so input is fed up to each one and the decoder is
+ * checked for output there.
+ */
+std::shared_ptr<Block> Bzip2BlockReader::Private::recover(std::shared_ptr<Block> first) {
+    Decompressor decoder;
+    BitWriter writer;
+    writer.write(STREAM_HEADER, 32);
+    writer.copy(first->payload, 0, first->bits);
+    std::shared_ptr<Block> merged(new Block);
+    qint64 end = 32 + first->bits;
+    qint64 fed = 0;
+    for (int i = 0;; ++i) {
+        // the byte holding the last bit is completed by the next magic
+        this->fill();
+        std::shared_ptr<Block> next;
+        if (!this->queue.empty()) {
+            next = this->queue.front();
+            writer.copy(next->payload, 0, next->bits);
+        } else {
+            writer.finish();
+        }
+        const QByteArray & bytes = writer.bytes();
+        qint64 last = (end - 1) / 8;
+        if (!decoder.feed(bytes.constData() + fed, last - fed, merged->output) || !merged->output.isEmpty()) {
+            break;
+        }
+        if (!decoder.feed(bytes.constData() + last, 1, merged->output)) {
+            break;
+        }
+        if (!merged->output.isEmpty()) {
+            // the block ends at this magic
+            merged->ok = true;
+            return merged;
+        }
+        fed = last + 1;
+        if (!next || i == MAX_MERGE) {
+            break;
+        }
+        this->queue.pop_front();
+        end += next->bits;
+    }
+    throw ArchiveException("broken bzip2 stream");
+}
+
+Bzip2BlockReader::Bzip2BlockReader(QIODevice * source, int threads)
+    : p_(new Private(source, threads)) {
+}
+
+qint64 Bzip2BlockReader::read(char * data, qint64 maxSize) {
+    qint64 total = 0;
+    while (total < maxSize) {
+        if (this->p_->cursor < this->p_->current.size()) {
+            qint64 n = std::min<qint64>(maxSize - total, this->p_->current.size() - this->p_->cursor);
+            std::memcpy(data + total, this->p_->current.constData() + this->p_->cursor, n);
+            this->p_->cursor += n;
+            total += n;
+        } else if (!this->p_->advance()) {
+            break;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file bzip2blockreader.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_BZIP2BLOCKREADER_HPP
+#define KOMIX_MODEL_ARCHIVE_BZIP2BLOCKREADER_HPP
+
+#include <QtCore/QIODevice>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Decompresses bzip2 blocks in parallel
+ *
+ * bzip2 blocks are independent. Their boundaries are found by the bit
+ * aligned block magic, and each block is wrapped as a standalone stream
+ * and decompressed in its own thread. Output is returned in order.
+ *
+ * The magic may appear inside compressed data by chance; a block which
+ * fails to decompress is decoded again by a sequential decoder, along
+ * with the following ones until the decoder reaches its real end.
+ */
+class Bzip2BlockReader {
+public:
+    /**
+     * @brief Constructor
+     * @param source opened bzip2 device, concatenated streams are allowed
+     * @param threads count of decompressing threads
+     */
+    Bzip2BlockReader(QIODevice * source, int threads);
+
+    /**
+     * @brief Read decompressed data
+     * @return bytes read, 0 on end of stream
+     * @throw KomiX::exception::ArchiveException on broken stream
+     */
+    qint64 read(char * data, qint64 maxSize);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,324 @@
+/**
+ * @file compresseddevice.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "bzip2blockreader.hpp"
+#include "compresseddevice.hpp"
+
+#include <QtCore/QThread>
+
+#include <bzlib.h>
+#include <lzma.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const qint64 CHUNK_SIZE = 256 * 1024;
+
+/// decoder interface of each format
+class Codec {
+public:
+    Codec()
+        : input()
+        , end(false) {
+    }
+    virtual ~Codec() {
+    }
+
+    /// decompress at most @p maxSize bytes, return 0 on end of stream
+    virtual qint64 decode(QIODevice * source, char * data, qint64 maxSize) = 0;
+    /// record access points, if the format supports
+    virtual void setIndex(std::shared_ptr<KomiX::model::archive::GzipIndex> /*index*/) {
+    }
+
+protected:
+    /// refill input buffer, return false if @p source is exhausted
+    bool fill(QIODevice * source) {
+        this->input = source->read(CHUNK_SIZE);
+        return !this->input.isEmpty();
+    }
+
+    QByteArray input;
+    bool end;
+};
+
+class GzipCodec : public Codec {
+public:
+    GzipCodec()
+        : Codec()
+        , index()
+        , totalIn(0)
+        , totalOut(0) {
+        std::memset(&this->zs, 0, sizeof(this->zs));
+        // 32 enables gzip header detection
+        if (inflateInit2(&this->zs, MAX_WBITS + 32) != Z_OK) {
+            throw KomiX::exception::ArchiveException("can not initialize zlib");
+        }
+    }
+
+    virtual ~GzipCodec() {
+        inflateEnd(&this->zs);
+    }
+
+    virtual qint64 decode(QIODevice * source, char * data, qint64 maxSize) {
+        this->zs.next_out = reinterpret_cast<Bytef *>(data);
+        this->zs.avail_out = std::min<qint64>(maxSize, UINT_MAX);
+        while (this->zs.avail_out > 0 && !this->end) {
+            if (this->zs.avail_in == 0) {
+                if (!this->fill(source)) {
+                    throw KomiX::exception::ArchiveException("unexpected end of gzip stream");
+                }
+                this->zs.next_in = reinterpret_cast<Bytef *>(this->input.data());
+                this->zs.avail_in = this->input.size();
+            }
+            uInt availIn = this->zs.avail_in;
+            uInt availOut = this->zs.avail_out;
+            // stop at block boundaries to take access points
+            int ret = inflate(&this->zs, this->index ? Z_BLOCK : Z_NO_FLUSH);
+            this->totalIn += availIn - this->zs.avail_in;
+            this->totalOut += availOut - this->zs.avail_out;
+            if (ret == Z_STREAM_END) {
+                if (this->zs.avail_in == 0 && source->atEnd()) {
+                    this->end = true;
+                } else {
+                    // another gzip member follows, its window starts empty
+                    inflateReset(&this->zs);
+                }
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                throw KomiX::exception::ArchiveException("broken gzip stream");
+            } else if (this->index && (this->zs.data_type & 128) && !(this->zs.data_type & 64) && this->index->isDue(this->totalOut)) {
+                // also right after the header of a member, the window
+                // holds this member only, so reads start inside it
+                this->addPoint();
+            }
+        }
+        return reinterpret_cast<char *>(this->zs.next_out) - data;
+    }
+
+    virtual void setIndex(std::shared_ptr<KomiX::model::archive::GzipIndex> index) {
+        this->index = index;
+    }
+
+private:
+    void addPoint() {
+        QByteArray window(32768, '\0');
+        uInt length = window.size();
+        inflateGetDictionary(&this->zs, reinterpret_cast<Bytef *>(window.data()), &length);
+        window.truncate(length);
+        this->index->addPoint(this->totalOut, this->totalIn, this->zs.data_type & 7, window);
+    }
+
+    z_stream zs;
+    std::shared_ptr<KomiX::model::archive::GzipIndex> index;
+    qint64 totalIn;
+    qint64 totalOut;
+};
+
+class Bzip2Codec : public Codec {
+public:
+    Bzip2Codec()
+        : Codec() {
+        std::memset(&this->bs, 0, sizeof(this->bs));
+        if (BZ2_bzDecompressInit(&this->bs, 0, 0) != BZ_OK) {
+            throw KomiX::exception::ArchiveException("can not initialize libbz2");
+        }
+    }
+
+    virtual ~Bzip2Codec() {
+        BZ2_bzDecompressEnd(&this->bs);
+    }
+
+    virtual qint64 decode(QIODevice * source, char * data, qint64 maxSize) {
+        this->bs.next_out = data;
+        this->bs.avail_out = std::min<qint64>(maxSize, UINT_MAX);
+        while (this->bs.avail_out > 0 && !this->end) {
+            if (this->bs.avail_in == 0) {
+                if (!this->fill(source)) {
+                    throw KomiX::exception::ArchiveException("unexpected end of bzip2 stream");
+                }
+                this->bs.next_in = this->input.data();
+                this->bs.avail_in = this->input.size();
+            }
+            int ret = BZ2_bzDecompress(&this->bs);
+            if (ret == BZ_STREAM_END) {
+                if (this->bs.avail_in == 0 && source->atEnd()) {
+                    this->end = true;
+                } else {
+                    // another bzip2 stream follows, keep pending input
+                    char * nextIn = this->bs.next_in;
+                    unsigned int availIn = this->bs.avail_in;
+                    char * nextOut = this->bs.next_out;
+                    unsigned int availOut = this->bs.avail_out;
+                    BZ2_bzDecompressEnd(&this->bs);
+                    std::memset(&this->bs, 0, sizeof(this->bs));
+                    if (BZ2_bzDecompressInit(&this->bs, 0, 0) != BZ_OK) {
+                        throw KomiX::exception::ArchiveException("can not initialize libbz2");
+                    }
+                    this->bs.next_in = nextIn;
+                    this->bs.avail_in = availIn;
+                    this->bs.next_out = nextOut;
+                    this->bs.avail_out = availOut;
+                }
+            } else if (ret != BZ_OK) {
+                throw KomiX::exception::ArchiveException("broken bzip2 stream");
+            }
+        }
+        return this->bs.next_out - data;
+    }
+
+private:
+    bz_stream bs;
+};
+
+/// bzip2 blocks are decompressed across cores
+class ParallelBzip2Codec : public Codec {
+public:
+    explicit ParallelBzip2Codec(int threads)
+        : Codec()
+        , threads(threads)
+        , reader() {
+    }
+
+    virtual qint64 decode(QIODevice * source, char * data, qint64 maxSize) {
+        if (!this->reader) {
+            this->reader.reset(new KomiX::model::archive::Bzip2BlockReader(source, this->threads));
+        }
+        return this->reader->read(data, maxSize);
+    }
+
+private:
+    int threads;
+    std::shared_ptr<KomiX::model::archive::Bzip2BlockReader> reader;
+};
+
+class XzCodec : public Codec {
+public:
+    XzCodec()
+        : Codec() {
+        lzma_stream init = LZMA_STREAM_INIT;
+        this->ls = init;
+        // accepts both .xz and legacy .lzma
+        if (lzma_auto_decoder(&this->ls, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            throw KomiX::exception::ArchiveException("can not initialize liblzma");
+        }
+    }
+
+    virtual ~XzCodec() {
+        lzma_end(&this->ls);
+    }
+
+    virtual qint64 decode(QIODevice * source, char * data, qint64 maxSize) {
+        this->ls.next_out = reinterpret_cast<uint8_t *>(data);
+        this->ls.avail_out = maxSize;
+        while (this->ls.avail_out > 0 && !this->end) {
+            lzma_action action = LZMA_RUN;
+            if (this->ls.avail_in == 0) {
+                if (this->fill(source)) {
+                    this->ls.next_in = reinterpret_cast<const uint8_t *>(this->input.constData());
+                    this->ls.avail_in = this->input.size();
+                } else {
+                    // tell the decoder there is no more concatenated stream
+                    action = LZMA_FINISH;
+                }
+            }
+            lzma_ret ret = lzma_code(&this->ls, action);
+            if (ret == LZMA_STREAM_END) {
+                this->end = true;
+            } else if (ret != LZMA_OK) {
+                throw KomiX::exception::ArchiveException("broken xz stream");
+            }
+        }
+        return reinterpret_cast<char *>(this->ls.next_out) - data;
+    }
+
+private:
+    lzma_stream ls;
+};
+
+Codec * createCodec(KomiX::model::archive::CompressedDevice::Format format) {
+    switch (format) {
+        case KomiX::model::archive::CompressedDevice::Gzip:
+            return new GzipCodec;
+        case KomiX::model::archive::CompressedDevice::Bzip2:
+            if (QThread::idealThreadCount() > 1) {
+                return new ParallelBzip2Codec(QThread::idealThreadCount());
+            }
+            return new Bzip2Codec;
+        case KomiX::model::archive::CompressedDevice::Xz:
+            return new XzCodec;
+        default:
+            throw KomiX::exception::ArchiveException("unknown compression format");
+    }
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class CompressedDevice::Private {
+public:
+    Private(std::shared_ptr<QIODevice> source, Format format);
+
+    std::shared_ptr<QIODevice> source;
+    std::shared_ptr<Codec> codec;
+};
+}
+}
+}
+
+using KomiX::model::archive::CompressedDevice;
+using KomiX::exception::ArchiveException;
+
+CompressedDevice::Private::Private(std::shared_ptr<QIODevice> source, Format format)
+    : source(source)
+    , codec(createCodec(format)) {
+}
+
+CompressedDevice::CompressedDevice(std::shared_ptr<QIODevice> source, Format format)
+    : QIODevice()
+    , p_(new Private(source, format)) {
+}
+
+void CompressedDevice::setIndex(std::shared_ptr<GzipIndex> index) {
+    this->p_->codec->setIndex(index);
+}
+
+bool CompressedDevice::isSequential() const {
+    return true;
+}
+
+qint64 CompressedDevice::readData(char * data, qint64 maxSize) {
+    try {
+        return this->p_->codec->decode(this->p_->source.get(), data, maxSize);
+    } catch (ArchiveException & e) {
+        this->setErrorString(e.getMessage());
+        return -1;
+    }
+}
+
+qint64 CompressedDevice::writeData(const char * /*data*/, qint64 /*maxSize*/) {
+    return -1;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file compresseddevice.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_COMPRESSEDDEVICE_HPP
+#define KOMIX_MODEL_ARCHIVE_COMPRESSEDDEVICE_HPP
+
+#include "gzipindex.hpp"
+
+#include <QtCore/QIODevice>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Sequential device which decompresses another device
+ *
+ * Concatenated streams are read as one.
+ */
+class CompressedDevice : public QIODevice {
+public:
+    /// Compression format
+    enum Format {
+        /// gzip, by zlib
+        Gzip,
+        /// bzip2, by libbz2
+        Bzip2,
+        /// xz and legacy lzma, by liblzma
+        Xz
+    };
+
+    /**
+     * @brief Constructor
+     * @param source opened compressed device
+     * @param format compression format of @p source
+     * @throw KomiX::exception::ArchiveException if the decoder can not be initialized
+     */
+    CompressedDevice(std::shared_ptr<QIODevice> source, Format format);
+
+    /**
+     * @brief Record access points into @p index while reading
+     *
+     * Only gzip streams can be indexed, others ignore it.
+     */
+    void setIndex(std::shared_ptr<GzipIndex> index);
+
+    /// Overrides from QIODevice
+    virtual bool isSequential() const;
+
+protected:
+    virtual qint64 readData(char * data, qint64 maxSize);
+    virtual qint64 writeData(const char * data, qint64 maxSize);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,345 @@
+/**
+ * @file contentstore.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "contentstore.hpp"
+#include "extractioncache.hpp"
+#include "extractionscheduler.hpp"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
+#include <QtCore/QTextStream>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <cstdio>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#endif
+
+#include <zlib.h>
+
+namespace {
+
+const char * const OBJECTS_NAME = ".objects";
+const char * const MANIFEST_NAME = ".manifest";
+const qint64 CHUNK_SIZE = 256 * 1024;
+
+bool hardLink(const QString & target, const QString & link) {
+#if defined(Q_OS_UNIX)
+    return ::link(QFile::encodeName(target).constData(), QFile::encodeName(link).constData()) == 0;
+#elif defined(Q_OS_WIN32)
+    return CreateHardLinkW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(link).utf16()),
+                           reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(target).utf16()), NULL) != 0;
+#else
+    Q_UNUSED(target);
+    Q_UNUSED(link);
+    return false;
+#endif
+}
+
+/// 0 if @p path does not exist
+int linkCount(const QString & path) {
+#if defined(Q_OS_UNIX)
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return 0;
+    }
+    return static_cast<int>(st.st_nlink);
+#elif defined(Q_OS_WIN32)
+    HANDLE file = CreateFileW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(path).utf16()), 0,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL ok = GetFileInformationByHandle(file, &info);
+    CloseHandle(file);
+    return ok ? static_cast<int>(info.nNumberOfLinks) : 0;
+#else
+    return QFile::exists(path) ? 1 : 0;
+#endif
+}
+
+/// replaces @p to at once, readers see either file
+bool replaceFile(const QString & from, const QString & to) {
+#if defined(Q_OS_UNIX)
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#elif defined(Q_OS_WIN32)
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(to).utf16()), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return QFile::remove(to) && QFile::rename(from, to);
+#endif
+}
+
+QString bucketName(quint32 crc32, qint64 size) {
+    return QString("%1-%2").arg(crc32, 8, 16, QChar('0')).arg(size);
+}
+
+class Adopter : public QRunnable {
+public:
+    Adopter(const QDir & dir, const QStringList & names)
+        : QRunnable()
+        , dir(dir)
+        , names(names) {
+    }
+
+    virtual void run() {
+        foreach (QString name, this->names) {
+            KomiX::model::archive::ContentStore::instance().adopt(this->dir, name);
+        }
+    }
+
+private:
+    QDir dir;
+    QStringList names;
+};
+
+/// unlinks pages of a deleted archive directory, then drops their objects
+class Releaser : public QRunnable {
+public:
+    Releaser(const QDir & dir, const QStringList & names, const QDir & root, const QStringList & ids, QMutex * lock)
+        : QRunnable()
+        , dir(dir)
+        , names(names)
+        , root(root)
+        , ids(ids)
+        , lock(lock) {
+    }
+
+    virtual void run() {
+        // the sweeper may be on them too, either way they are gone after this
+        foreach (QString name, this->names) {
+            this->dir.remove(name);
+        }
+        QMutexLocker locker(this->lock);
+        Q_UNUSED(locker);
+        foreach (QString id, this->ids) {
+            if (linkCount(this->root.filePath(id)) == 1) {
+                this->root.remove(id);
+                this->root.rmdir(id.section('/', 0, 0));
+            }
+        }
+    }
+
+private:
+    QDir dir;
+    QStringList names;
+    QDir root;
+    QStringList ids;
+    QMutex * lock;
+};
+
+class Collector : public QRunnable {
+public:
+    Collector(const QDir & root, QMutex * lock)
+        : QRunnable()
+        , root(root)
+        , lock(lock) {
+    }
+
+    virtual void run() {
+        foreach (QString bucket, this->root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            QMutexLocker locker(this->lock);
+            Q_UNUSED(locker);
+            QDir dir(this->root.filePath(bucket));
+            foreach (QString object, dir.entryList(QDir::Files)) {
+                // only the store itself links to it
+                if (linkCount(dir.filePath(object)) == 1) {
+                    dir.remove(object);
+                }
+            }
+            this->root.rmdir(bucket);
+        }
+    }
+
+private:
+    QDir root;
+    QMutex * lock;
+};
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class ContentStore::Private {
+public:
+    Private();
+
+    void load(const QDir & dir, QStringList & names, QStringList & ids) const;
+    void record(const QDir & dir, const QString & name, const QString & id);
+
+    QDir root;
+    bool prepared;
+    QMutex lock;
+};
+}
+}
+}
+
+using KomiX::model::archive::ContentStore;
+
+ContentStore::Private::Private()
+    : root()
+    , prepared(false)
+    , lock() {
+    const ExtractionCache & cache = ExtractionCache::instance();
+    if (!cache.isPrepared()) {
+        return;
+    }
+    // hidden, so the cache does not take it as an archive
+    QDir dir = cache.getRoot();
+    if (!dir.mkpath(OBJECTS_NAME) || !dir.cd(OBJECTS_NAME)) {
+        qWarning("can not make object dir");
+        return;
+    }
+    this->root = dir;
+    this->prepared = true;
+}
+
+void ContentStore::Private::load(const QDir & dir, QStringList & names, QStringList & ids) const {
+    QFile fin(dir.filePath(MANIFEST_NAME));
+    if (!fin.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    QTextStream in(&fin);
+    in.setCodec("UTF-8");
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        int sep = line.indexOf('\t');
+        if (sep > 0) {
+            ids << line.left(sep);
+            names << line.mid(sep + 1);
+        }
+    }
+}
+
+// must be called with lock held
+void ContentStore::Private::record(const QDir & dir, const QString & name, const QString & id) {
+    QFile fout(dir.filePath(MANIFEST_NAME));
+    if (!fout.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        return;
+    }
+    QTextStream out(&fout);
+    out.setCodec("UTF-8");
+    out << id << '\t' << name << '\n';
+}
+
+ContentStore & ContentStore::instance() {
+    static ContentStore store;
+    return store;
+}
+
+ContentStore::ContentStore()
+    : p_(new Private) {
+}
+
+bool ContentStore::isPrepared() const {
+    return this->p_->prepared;
+}
+
+void ContentStore::adopt(const QDir & dir, const QString & name) {
+    if (!this->p_->prepared) {
+        return;
+    }
+    QString path = dir.filePath(name);
+    // missing, or linked already
+    if (linkCount(path) != 1) {
+        return;
+    }
+    QFile fin(path);
+    if (!fin.open(QIODevice::ReadOnly) || fin.size() <= 0) {
+        return;
+    }
+    uLong crc = crc32(0L, Z_NULL, 0);
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    QByteArray chunk(CHUNK_SIZE, '\0');
+    qint64 n = 0;
+    while ((n = fin.read(chunk.data(), chunk.size())) > 0) {
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(chunk.constData()), static_cast<uInt>(n));
+        md5.addData(chunk.constData(), static_cast<int>(n));
+    }
+    if (n < 0) {
+        return;
+    }
+    QString bucket = bucketName(static_cast<quint32>(crc), fin.size());
+    QString id = bucket + "/" + QString::fromLatin1(md5.result().toHex());
+    fin.close();
+
+    QMutexLocker locker(&this->p_->lock);
+    Q_UNUSED(locker);
+    this->p_->root.mkpath(bucket);
+    QString object = this->p_->root.filePath(id);
+    if (QFile::exists(object)) {
+        // same content elsewhere, drop this copy
+        QString link = path + ".link";
+        QFile::remove(link);
+        if (!hardLink(object, link)) {
+            return;
+        }
+        if (!replaceFile(link, path)) {
+            QFile::remove(link);
+            return;
+        }
+    } else if (!hardLink(path, object)) {
+        return;
+    }
+    this->p_->record(dir, name, id);
+}
+
+void ContentStore::adoptLater(const QDir & dir, const QStringList & names) {
+    if (!this->p_->prepared || names.isEmpty()) {
+        return;
+    }
+    // nobody waits for it, keep the slots for extraction
+    ExtractionScheduler::instance().start(new Adopter(dir, names), ExtractionScheduler::Idle, nullptr);
+}
+
+void ContentStore::release(const QDir & dir) {
+    if (!this->p_->prepared) {
+        delTreeLater(dir);
+        return;
+    }
+    QStringList names;
+    QStringList ids;
+    // read before the sweeper gets to it
+    this->p_->load(dir, names, ids);
+    QString trash = delTreeLater(dir);
+    if (ids.isEmpty()) {
+        return;
+    }
+    ExtractionScheduler::instance().start(new Releaser(trash, names, this->p_->root, ids, &this->p_->lock), ExtractionScheduler::Idle, nullptr);
+}
+
+void ContentStore::collect() {
+    if (!this->p_->prepared) {
+        return;
+    }
+    ExtractionScheduler::instance().start(new Collector(this->p_->root, &this->p_->lock), ExtractionScheduler::Idle, nullptr);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file contentstore.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_CONTENTSTORE_HPP
+#define KOMIX_MODEL_ARCHIVE_CONTENTSTORE_HPP
+
+#include <QtCore/QDir>
+#include <QtCore/QStringList>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Content-addressed pages shared by extracted archives
+ *
+ * Objects live in a hidden directory of the extraction cache, grouped by
+ * CRC-32 and size and named by the MD5 of their content. Extracted pages
+ * are hard links to objects, so identical pages of different archives
+ * take disk space once. Pages are shared when they are adopted after
+ * extraction, by their MD5; nothing is taken from the store before a
+ * page is extracted, since CRC-32 and size alone do not prove it is the
+ * same. Each archive directory keeps a manifest of the objects it links,
+ * so they can be dropped along with it.
+ */
+class ContentStore {
+public:
+    /// Get the global store
+    static ContentStore & instance();
+
+    /// Check if the object directory is usable
+    bool isPrepared() const;
+
+    /**
+     * @brief Share an extracted page
+     * @param dir archive directory
+     * @param name path relative to @p dir
+     *
+     * The page is read once to hash it. If the same content is known, the
+     * page is replaced by a link to it; otherwise the page becomes a new
+     * object. This function is thread-safe.
+     */
+    void adopt(const QDir & dir, const QString & name);
+    /// adopt() @p names in background
+    void adoptLater(const QDir & dir, const QStringList & names);
+    /**
+     * @brief Delete archive directory @p dir in background
+     *
+     * Objects no other archive directory links to are removed with it.
+     */
+    void release(const QDir & dir);
+    /// Remove objects no archive directory links to, in background
+    void collect();
+
+private:
+    ContentStore();
+    ContentStore(const ContentStore &);
+    ContentStore & operator=(const ContentStore &);
+
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
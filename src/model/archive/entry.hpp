@@ -0,0 +1,74 @@
+/**
+ * @file entry.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_ENTRY_HPP
+#define KOMIX_MODEL_ARCHIVE_ENTRY_HPP
+
+#include <QtCore/QString>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief An item in the table of contents of an archive
+ *
+ * Fields that a backend does not know are left as zero.
+ */
+struct Entry {
+    Entry()
+        : name()
+        , offset(0)
+        , packedSize(0)
+        , size(0)
+        , method(0)
+        , crc32(0)
+        , width(0)
+        , height(0)
+        , container()
+        , block(0) {
+    }
+
+    /// path inside the archive
+    QString name;
+    /// offset of the entry header in the archive
+    qint64 offset;
+    /// compressed size
+    qint64 packedSize;
+    /// uncompressed size
+    qint64 size;
+    /// compression method, backend specific
+    int method;
+    /// CRC-32 of uncompressed data
+    quint32 crc32;
+    /// image width, 0 if not known yet
+    qint32 width;
+    /// image height, 0 if not known yet
+    qint32 height;
+    /// the entry of the outer archive which holds this one, empty if not nested
+    QString container;
+    /// solid block of the entry, entries sharing a block are decoded in one pass
+    qint32 block;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ * @file extractioncache.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "contentstore.hpp"
+#include "extractioncache.hpp"
+#include "extractionscheduler.hpp"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDirIterator>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRegExp>
+#include <QtCore/QRunnable>
+#include <QtCore/QSaveFile>
+#include <QtCore/QSet>
+#include <QtCore/QSettings>
+#include <QtCore/QStandardPaths>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const quint32 INDEX_MAGIC = 0x4b584349;
+const quint32 INDEX_VERSION = 1;
+const char * const INDEX_NAME = "index";
+/// in MiB
+const qint64 DEFAULT_BUDGET = 1024;
+
+qint64 dirSize(const QString & path) {
+    qint64 sum = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+#ifdef Q_OS_UNIX
+        // a page shared through ContentStore is split among its archives
+        struct stat st;
+        if (::stat(QFile::encodeName(it.filePath()).constData(), &st) == 0 && st.st_nlink > 2) {
+            sum += st.st_size / (st.st_nlink - 1);
+            continue;
+        }
+#endif
+        sum += it.fileInfo().size();
+    }
+    return sum;
+}
+
+class Evictor : public QRunnable {
+public:
+    virtual void run() {
+        KomiX::model::archive::ExtractionCache::instance().evict();
+    }
+};
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class ExtractionCache::Private {
+public:
+    struct Record {
+        Record()
+            : lastUsed(0)
+            , size(-1) {
+        }
+        Record(qint64 lastUsed, qint64 size)
+            : lastUsed(lastUsed)
+            , size(size) {
+        }
+
+        /// msecs since epoch
+        qint64 lastUsed;
+        /// bytes, -1 means unknown
+        qint64 size;
+    };
+
+    Private();
+
+    void load();
+    void save() const;
+
+    QDir root;
+    bool prepared;
+    QHash<QString, Record> records;
+    QSet<QString> pinned;
+    /// released since their size was counted
+    QSet<QString> changed;
+    mutable QMutex lock;
+};
+}
+}
+}
+
+using KomiX::model::archive::ExtractionCache;
+
+ExtractionCache::Private::Private()
+    : root()
+    , prepared(false)
+    , records()
+    , pinned()
+    , changed()
+    , lock() {
+    QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (path.isEmpty()) {
+        qWarning("can not find cache location");
+        return;
+    }
+    QDir cacheDir(path);
+    if (!cacheDir.mkpath("archives")) {
+        qWarning("can not make cache dir");
+        return;
+    }
+    cacheDir.cd("archives");
+    this->root = cacheDir;
+    this->prepared = true;
+    this->load();
+}
+
+void ExtractionCache::Private::load() {
+    QFile fin(this->root.filePath(INDEX_NAME));
+    if (fin.open(QIODevice::ReadOnly)) {
+        QDataStream in(&fin);
+        quint32 magic = 0, version = 0, count = 0;
+        in >> magic >> version >> count;
+        if (magic == INDEX_MAGIC && version == INDEX_VERSION) {
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                QString key;
+                qint64 lastUsed = 0, size = -1;
+                in >> key >> lastUsed >> size;
+                this->records.insert(key, Record(lastUsed, size));
+            }
+        }
+    }
+
+    // the index may be stale if the last session did not quit normally
+    QStringList dirs = this->root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    // trash of deleted directories is not an entry
+    dirs = dirs.filter(QRegExp("^[^.]"));
+    foreach (QString key, this->records.keys()) {
+        if (!dirs.contains(key)) {
+            this->records.remove(key);
+        }
+    }
+    foreach (QString key, dirs) {
+        if (!this->records.contains(key)) {
+            QFileInfo fi(this->root.filePath(key));
+            this->records.insert(key, Record(fi.lastModified().toMSecsSinceEpoch(), -1));
+        }
+    }
+}
+
+void ExtractionCache::Private::save() const {
+    QSaveFile fout(this->root.filePath(INDEX_NAME));
+    if (!fout.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&fout);
+    out << INDEX_MAGIC << INDEX_VERSION << static_cast<quint32>(this->records.size());
+    for (auto it = this->records.begin(); it != this->records.end(); ++it) {
+        out << it.key() << it.value().lastUsed << it.value().size;
+    }
+    fout.commit();
+}
+
+ExtractionCache & ExtractionCache::instance() {
+    static ExtractionCache cache;
+    return cache;
+}
+
+ExtractionCache::ExtractionCache()
+    : p_(new Private) {
+}
+
+bool ExtractionCache::isPrepared() const {
+    return this->p_->prepared;
+}
+
+QDir ExtractionCache::getRoot() const {
+    return this->p_->root;
+}
+
+bool ExtractionCache::contains(const QString & key) const {
+    return this->p_->prepared && this->p_->root.exists(key);
+}
+
+QDir ExtractionCache::getDirectory(const QString & key) const {
+    QDir dir(this->p_->root);
+    if (!dir.exists(key)) {
+        dir.mkdir(key);
+    }
+    dir.cd(key);
+    return dir;
+}
+
+void ExtractionCache::acquire(const QString & key) {
+    {
+        QMutexLocker locker(&this->p_->lock);
+        Q_UNUSED(locker);
+        // the size is counted again when it is released
+        this->p_->records[key].lastUsed = QDateTime::currentMSecsSinceEpoch();
+        this->p_->pinned.insert(key);
+    }
+    this->evictLater();
+}
+
+void ExtractionCache::release(const QString & key) {
+    {
+        QMutexLocker locker(&this->p_->lock);
+        Q_UNUSED(locker);
+        this->p_->pinned.remove(key);
+        // pages were written meanwhile
+        this->p_->changed.insert(key);
+    }
+    this->evictLater();
+}
+
+qint64 ExtractionCache::getBudget() const {
+    return QSettings().value("cache_budget", DEFAULT_BUDGET).toLongLong() * 1024 * 1024;
+}
+
+void ExtractionCache::evict() {
+    if (!this->p_->prepared) {
+        return;
+    }
+    qint64 budget = this->getBudget();
+
+    QStringList unknown;
+    {
+        QMutexLocker locker(&this->p_->lock);
+        Q_UNUSED(locker);
+        for (auto it = this->p_->records.begin(); it != this->p_->records.end(); ++it) {
+            if (it.value().size < 0 || this->p_->changed.contains(it.key())) {
+                unknown.push_back(it.key());
+            }
+        }
+        this->p_->changed.clear();
+    }
+    // counted without the lock, models acquire keys meanwhile
+    QHash<QString, qint64> sizes;
+    foreach (QString key, unknown) {
+        sizes.insert(key, dirSize(this->p_->root.filePath(key)));
+    }
+
+    QStringList victims;
+    {
+        QMutexLocker locker(&this->p_->lock);
+        Q_UNUSED(locker);
+        for (auto it = sizes.begin(); it != sizes.end(); ++it) {
+            // released again while counting, the next eviction counts it
+            if (this->p_->records.contains(it.key()) && !this->p_->changed.contains(it.key())) {
+                this->p_->records[it.key()].size = it.value();
+            }
+        }
+
+        qint64 total = 0;
+        std::vector<std::pair<qint64, QString>> lru;
+        for (auto it = this->p_->records.begin(); it != this->p_->records.end(); ++it) {
+            total += qMax(it.value().size, Q_INT64_C(0));
+            lru.push_back(std::make_pair(it.value().lastUsed, it.key()));
+        }
+        std::sort(lru.begin(), lru.end());
+
+        for (auto it = lru.begin(); it != lru.end() && total > budget; ++it) {
+            if (this->p_->pinned.contains(it->second)) {
+                continue;
+            }
+            total -= qMax(this->p_->records.take(it->second).size, Q_INT64_C(0));
+            victims.push_back(it->second);
+        }
+        this->p_->save();
+    }
+    foreach (QString key, victims) {
+        // also drops pages only this archive had
+        ContentStore::instance().release(this->p_->root.filePath(key));
+    }
+}
+
+void ExtractionCache::evictLater() {
+    if (!this->p_->prepared) {
+        return;
+    }
+    // counting directories takes a while, keep it off the caller
+    ExtractionScheduler::instance().start(new Evictor, ExtractionScheduler::Idle, nullptr);
+}
+
+void ExtractionCache::save() const {
+    QMutexLocker locker(&this->p_->lock);
+    Q_UNUSED(locker);
+    this->p_->save();
+}
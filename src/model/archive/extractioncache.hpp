@@ -0,0 +1,86 @@
+/**
+ * @file extractioncache.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_EXTRACTIONCACHE_HPP
+#define KOMIX_MODEL_ARCHIVE_EXTRACTIONCACHE_HPP
+
+#include <QtCore/QDir>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Persistent cache of extracted archives
+ *
+ * Each archive is extracted into its own directory under the user cache
+ * location, so it can be reused by later sessions. A small index file
+ * records the last access time and size of each directory; when the
+ * total size exceeds the budget, least recently used directories are
+ * removed. A directory is counted again only after it was released.
+ */
+class ExtractionCache {
+public:
+    /// Get the global cache
+    static ExtractionCache & instance();
+
+    /// Check if the cache directory is usable
+    bool isPrepared() const;
+    /// Get the top-level cache directory
+    QDir getRoot() const;
+    /// Check if @p key was extracted before
+    bool contains(const QString & key) const;
+    /// Get directory of @p key, create it if not exists
+    QDir getDirectory(const QString & key) const;
+
+    /**
+     * @brief Mark @p key as used now
+     *
+     * An acquired key is never evicted until it is released. Eviction
+     * runs later in the idle lane of ExtractionScheduler.
+     */
+    void acquire(const QString & key);
+    /// The directory of @p key is not used anymore, evict later
+    void release(const QString & key);
+
+    /// Get budget in bytes
+    qint64 getBudget() const;
+    /// Remove least recently used directories until fit the budget
+    void evict();
+    /// evict() in the idle lane of ExtractionScheduler
+    void evictLater();
+    /// Write index file
+    void save() const;
+
+private:
+    ExtractionCache();
+    ExtractionCache(const ExtractionCache &);
+    ExtractionCache & operator=(const ExtractionCache &);
+
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,353 @@
+/**
+ * @file extractionscheduler.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "extractionscheduler_p.hpp"
+
+#include <QtCore/QDir>
+#include <QtCore/QRunnable>
+#include <QtCore/QSettings>
+#include <QtCore/QThread>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <cerrno>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#endif
+
+namespace {
+
+const int DEFAULT_LIMIT = 2;
+/// added to the nice value of background jobs
+const int NICENESS = 10;
+#ifdef Q_OS_UNIX
+const int MAX_NICE = 19;
+#endif
+#ifdef Q_OS_LINUX
+/// best-effort class, lowest level
+const int IOPRIO = (2 << 13) | 7;
+/// no class, follows the nice value
+const int NORMAL_IOPRIO = 0;
+#endif
+
+#ifdef Q_OS_UNIX
+/// nice value of the viewer itself, which may be niced already
+int normal() {
+    errno = 0;
+    int base = getpriority(PRIO_PROCESS, static_cast<id_t>(getpid()));
+    if (base == -1 && errno != 0) {
+        base = 0;
+    }
+    return base;
+}
+
+/// NICENESS below the viewer
+int lowered() {
+    return qMin(normal() + NICENESS, MAX_NICE);
+}
+#endif
+
+void lowerProcess(qint64 pid) {
+    if (pid <= 0) {
+        return;
+    }
+#if defined(Q_OS_UNIX)
+    setpriority(PRIO_PROCESS, static_cast<id_t>(pid), lowered());
+#ifdef Q_OS_LINUX
+    syscall(SYS_ioprio_set, 1, static_cast<int>(pid), IOPRIO);
+#endif
+#elif defined(Q_OS_WIN32)
+    HANDLE process = OpenProcess(PROCESS_SET_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (process) {
+        // also lowers I/O and memory priority
+        SetPriorityClass(process, BELOW_NORMAL_PRIORITY_CLASS);
+        CloseHandle(process);
+    }
+#endif
+}
+
+/// undo lowerProcess() of a running process
+void restoreProcess(qint64 pid) {
+    if (pid <= 0) {
+        return;
+    }
+#if defined(Q_OS_LINUX)
+    // per thread, and 7-Zip starts its threads after it was lowered
+    QStringList tids = QDir(QString("/proc/%1/task").arg(pid)).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    if (tids.isEmpty()) {
+        tids << QString::number(pid);
+    }
+    int nice = normal();
+    foreach (QString tid, tids) {
+        // raising nice back needs RLIMIT_NICE, the I/O priority always works
+        setpriority(PRIO_PROCESS, static_cast<id_t>(tid.toInt()), nice);
+        syscall(SYS_ioprio_set, 1, tid.toInt(), NORMAL_IOPRIO);
+    }
+#elif defined(Q_OS_UNIX)
+    setpriority(PRIO_PROCESS, static_cast<id_t>(pid), normal());
+#elif defined(Q_OS_WIN32)
+    HANDLE process = OpenProcess(PROCESS_SET_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (process) {
+        SetPriorityClass(process, NORMAL_PRIORITY_CLASS);
+        CloseHandle(process);
+    }
+#endif
+}
+
+void lowerThread() {
+#ifdef Q_OS_LINUX
+    // nice and ioprio are per thread on Linux, the pool reuses threads
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS, static_cast<id_t>(tid), lowered());
+    syscall(SYS_ioprio_set, 1, static_cast<int>(tid), IOPRIO);
+#else
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+#endif
+}
+
+/// runs a job, then reports back to the scheduler
+class Worker : public QRunnable {
+public:
+    Worker(QRunnable * job, bool background, quint64 id, QObject * scheduler)
+        : QRunnable()
+        , job(job)
+        , background(background)
+        , id(id)
+        , scheduler(scheduler) {
+    }
+
+    virtual void run() {
+        if (this->background) {
+            lowerThread();
+        }
+        this->job->run();
+        if (this->job->autoDelete()) {
+            delete this->job;
+        }
+        if (!this->scheduler) {
+            // idle job, not counted
+            return;
+        }
+        QMetaObject::invokeMethod(this->scheduler, "onRunnableDone", Qt::QueuedConnection, Q_ARG(quint64, this->id));
+    }
+
+private:
+    QRunnable * job;
+    bool background;
+    quint64 id;
+    QObject * scheduler;
+};
+
+int limit() {
+    return qMax(1, QSettings().value("extraction_jobs", DEFAULT_LIMIT).toInt());
+}
+
+} // end of namespace
+
+using KomiX::model::archive::ExtractionScheduler;
+
+ExtractionScheduler::Private::Private()
+    : QObject()
+    , serial(0)
+    , queue()
+    , running()
+    , hurried()
+    , processes()
+    , pool()
+    , idle() {
+    this->idle.setMaxThreadCount(1);
+}
+
+ExtractionScheduler::Private::~Private() {
+    // workers report back to this object
+    this->pool.waitForDone();
+    this->idle.waitForDone();
+}
+
+void ExtractionScheduler::Private::launch(const Job & job, Lane lane) {
+    this->running.insert(job.id, job.owner);
+    if (lane == Foreground) {
+        // tracked to be canceled, but does not take a slot
+        this->hurried.insert(job.id);
+    }
+    if (job.runnable) {
+        Worker * worker = new Worker(job.runnable, lane == Background, job.id, this);
+        if (lane == Background) {
+            this->pool.start(worker);
+        } else {
+            QThreadPool::globalInstance()->start(worker);
+        }
+        return;
+    }
+
+    QProcess * p = job.process;
+    this->processes.insert(p, job.id);
+    this->connect(p, SIGNAL(finished(int)), SLOT(onProcessFinished()));
+    this->connect(p, SIGNAL(error(QProcess::ProcessError)), SLOT(onProcessError(QProcess::ProcessError)));
+    this->connect(p, SIGNAL(destroyed(QObject *)), SLOT(onProcessDestroyed(QObject *)));
+    p->start(job.program, job.arguments, QIODevice::ReadOnly);
+    if (lane == Background) {
+        lowerProcess(p->processId());
+    }
+}
+
+void ExtractionScheduler::Private::drain() {
+    int n = limit();
+    this->pool.setMaxThreadCount(n);
+    while (!this->queue.empty() && this->running.size() - this->hurried.size() < n) {
+        Job job = this->queue.front();
+        this->queue.pop_front();
+        if (!job.runnable && !job.process) {
+            // deleted while waiting
+            continue;
+        }
+        this->launch(job, Background);
+    }
+}
+
+void ExtractionScheduler::Private::onProcessFinished() {
+    this->onProcessDestroyed(this->sender());
+}
+
+void ExtractionScheduler::Private::onProcessError(QProcess::ProcessError error) {
+    // no finished signal in this case
+    if (error == QProcess::FailedToStart) {
+        this->onProcessDestroyed(this->sender());
+    }
+}
+
+void ExtractionScheduler::Private::onProcessDestroyed(QObject * process) {
+    auto it = this->processes.find(process);
+    if (it == this->processes.end()) {
+        return;
+    }
+    this->running.remove(it.value());
+    this->hurried.remove(it.value());
+    this->processes.erase(it);
+    this->drain();
+}
+
+void ExtractionScheduler::Private::onRunnableDone(quint64 id) {
+    this->running.remove(id);
+    this->hurried.remove(id);
+    this->drain();
+}
+
+ExtractionScheduler & ExtractionScheduler::instance() {
+    static ExtractionScheduler scheduler;
+    return scheduler;
+}
+
+ExtractionScheduler::ExtractionScheduler()
+    : p_(new Private) {
+}
+
+int ExtractionScheduler::getLimit() const {
+    return limit();
+}
+
+void ExtractionScheduler::start(QProcess * process, const QString & program, const QStringList & arguments, Lane lane, QObject * owner) {
+    Private::Job job;
+    job.id = ++this->p_->serial;
+    job.owner = owner;
+    job.process = process;
+    job.program = program;
+    job.arguments = arguments;
+    job.runnable = nullptr;
+    if (lane == Foreground) {
+        this->p_->launch(job, Foreground);
+        return;
+    }
+    this->p_->queue.push_back(job);
+    this->p_->drain();
+}
+
+void ExtractionScheduler::start(QRunnable * runnable, Lane lane, QObject * owner) {
+    if (lane == Idle) {
+        this->p_->idle.start(new Worker(runnable, true, 0, nullptr));
+        return;
+    }
+    Private::Job job;
+    job.id = ++this->p_->serial;
+    job.owner = owner;
+    job.runnable = runnable;
+    if (lane == Foreground) {
+        this->p_->launch(job, Foreground);
+        return;
+    }
+    this->p_->queue.push_back(job);
+    this->p_->drain();
+}
+
+void ExtractionScheduler::hurry(QProcess * process) {
+    auto & queue = this->p_->queue;
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if (!it->runnable && it->process == process) {
+            Private::Job job = *it;
+            queue.erase(it);
+            this->p_->launch(job, Foreground);
+            return;
+        }
+    }
+
+    // usually running already, the page is in the block being extracted
+    auto it = this->p_->processes.find(process);
+    if (it == this->p_->processes.end() || this->p_->hurried.contains(it.value())) {
+        return;
+    }
+    restoreProcess(process->processId());
+    this->p_->hurried.insert(it.value());
+    // its slot is free for the next background job
+    this->p_->drain();
+}
+
+void ExtractionScheduler::cancel(QObject * owner) {
+    if (!owner) {
+        return;
+    }
+    auto & queue = this->p_->queue;
+    for (auto it = queue.begin(); it != queue.end();) {
+        if (it->owner != owner) {
+            ++it;
+            continue;
+        }
+        if (it->runnable) {
+            if (it->runnable->autoDelete()) {
+                delete it->runnable;
+            }
+        } else if (it->process) {
+            it->process->deleteLater();
+        }
+        it = queue.erase(it);
+    }
+    for (auto it = this->p_->processes.begin(); it != this->p_->processes.end(); ++it) {
+        if (this->p_->running.value(it.value()) == owner) {
+            QProcess * p = static_cast<QProcess *>(it.key());
+            // its slot is freed when it is destroyed
+            p->kill();
+            p->deleteLater();
+        }
+    }
+}
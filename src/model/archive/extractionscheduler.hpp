@@ -0,0 +1,109 @@
+/**
+ * @file extractionscheduler.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_EXTRACTIONSCHEDULER_HPP
+#define KOMIX_MODEL_ARCHIVE_EXTRACTIONSCHEDULER_HPP
+
+#include <QtCore/QStringList>
+
+#include <memory>
+
+class QObject;
+class QProcess;
+class QRunnable;
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Runs extraction jobs of all archives
+ *
+ * Background jobs, such as full extraction and prefetching, wait in one
+ * queue and at most "extraction_jobs" of them run at once. They run with
+ * lower CPU and I/O priority, so they never fight the page being
+ * decoded. Jobs in the fast lane are for entries the view is waiting on;
+ * they start at once with normal priority and do not count against the
+ * limit, so prefetching goes on while the view jumps around.
+ *
+ * Idle jobs are housekeeping nobody waits for; they run one at a time
+ * with low priority and never take a slot.
+ */
+class ExtractionScheduler {
+public:
+    enum Lane {
+        Background,
+        Foreground,
+        Idle
+    };
+
+    /// Get the global scheduler
+    static ExtractionScheduler & instance();
+
+    /// Get the count of background jobs allowed to run at once
+    int getLimit() const;
+
+    /**
+     * @brief Start @p process when there is room
+     * @param process not started yet, deleted by the caller when finished
+     * @param program program to run
+     * @param arguments program arguments
+     * @param lane fast lane or not, an idle process waits as a background one
+     * @param owner jobs are canceled with their owner, may be null
+     */
+    void start(QProcess * process, const QString & program, const QStringList & arguments, Lane lane, QObject * owner);
+    /**
+     * @brief Run @p runnable on a worker thread when there is room
+     * @param runnable deleted when done if auto-delete is set
+     * @param lane fast lane or not
+     * @param owner jobs are canceled with their owner, may be null
+     *
+     * Idle jobs are not tracked, so they can not be canceled.
+     * A running job can not be interrupted, it should check a flag of
+     * its owner.
+     */
+    void start(QRunnable * runnable, Lane lane, QObject * owner);
+    /**
+     * @brief Move @p process to the fast lane
+     *
+     * A waiting process starts at once. A running one gets its normal
+     * priority back, as far as the system allows, and frees its slot.
+     */
+    void hurry(QProcess * process);
+    /**
+     * @brief Drop everything of @p owner
+     *
+     * Waiting jobs are deleted, running processes are killed.
+     */
+    void cancel(QObject * owner);
+
+private:
+    ExtractionScheduler();
+    ExtractionScheduler(const ExtractionScheduler &);
+    ExtractionScheduler & operator=(const ExtractionScheduler &);
+
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
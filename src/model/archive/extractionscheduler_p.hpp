@@ -0,0 +1,79 @@
+/**
+ * @file extractionscheduler_p.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_EXTRACTIONSCHEDULER_HPP_
+#define KOMIX_MODEL_ARCHIVE_EXTRACTIONSCHEDULER_HPP_
+
+#include "extractionscheduler.hpp"
+
+#include <QtCore/QHash>
+#include <QtCore/QPointer>
+#include <QtCore/QProcess>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+
+#include <deque>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class ExtractionScheduler::Private : public QObject {
+    Q_OBJECT
+public:
+    struct Job {
+        quint64 id;
+        QObject * owner;
+        QPointer<QProcess> process;
+        QString program;
+        QStringList arguments;
+        QRunnable * runnable;
+    };
+
+    Private();
+    virtual ~Private();
+
+    void launch(const Job & job, Lane lane);
+    void drain();
+
+public slots:
+    void onProcessFinished();
+    void onProcessError(QProcess::ProcessError);
+    void onProcessDestroyed(QObject *);
+    void onRunnableDone(quint64 id);
+
+public:
+    quint64 serial;
+    std::deque<Job> queue;
+    // running jobs, to their owners
+    QHash<quint64, QObject *> running;
+    // running jobs of the fast lane, not counted against the limit
+    QSet<quint64> hurried;
+    QHash<QObject *, quint64> processes;
+    // threads of background runnables, all with low priority
+    QThreadPool pool;
+    // one thread of idle runnables, also with low priority
+    QThreadPool idle;
+};
+}
+}
+}
+
+#endif
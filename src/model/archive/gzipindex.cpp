@@ -0,0 +1,258 @@
+/**
+ * @file gzipindex.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "extractioncache.hpp"
+#include "gzipindex.hpp"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const quint32 INDEX_MAGIC = 0x4b58475a;
+const quint32 INDEX_VERSION = 1;
+const char * const INDEX_NAME = ".gzi";
+
+/// distance between access points, in uncompressed bytes
+const qint64 SPAN = 4 * 1024 * 1024;
+const qint64 CHUNK_SIZE = 64 * 1024;
+/// two offsets, the bit count and the window length
+const qint64 MIN_POINT_SIZE = 8 + 8 + 4 + 4;
+
+struct Point {
+    Point()
+        : out(0)
+        , in(0)
+        , bits(0)
+        , window() {
+    }
+
+    qint64 out;
+    qint64 in;
+    qint32 bits;
+    QByteArray window;
+};
+
+/// zlib stream which is always released
+class Inflater {
+public:
+    Inflater() {
+        std::memset(&this->zs, 0, sizeof(this->zs));
+        if (inflateInit2(&this->zs, -MAX_WBITS) != Z_OK) {
+            throw KomiX::exception::ArchiveException("can not initialize zlib");
+        }
+    }
+    ~Inflater() {
+        inflateEnd(&this->zs);
+    }
+
+    z_stream zs;
+};
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class GzipIndex::Private {
+public:
+    Private();
+
+    mutable QMutex lock;
+    std::vector<Point> points;
+};
+}
+}
+}
+
+using KomiX::model::archive::GzipIndex;
+using KomiX::exception::ArchiveException;
+
+GzipIndex::Private::Private()
+    : lock()
+    , points() {
+}
+
+GzipIndex::GzipIndex()
+    : p_(new Private) {
+}
+
+bool GzipIndex::isDue(qint64 out) const {
+    QMutexLocker locker(&this->p_->lock);
+    return this->p_->points.empty() || out - this->p_->points.back().out >= SPAN;
+}
+
+void GzipIndex::addPoint(qint64 out, qint64 in, int bits, const QByteArray & window) {
+    Point point;
+    point.out = out;
+    point.in = in;
+    point.bits = bits;
+    point.window = window;
+    QMutexLocker locker(&this->p_->lock);
+    this->p_->points.push_back(point);
+}
+
+QByteArray GzipIndex::read(const QString & path, qint64 offset, qint64 size) const {
+    Point point;
+    {
+        QMutexLocker locker(&this->p_->lock);
+        auto it = std::upper_bound(this->p_->points.begin(), this->p_->points.end(), offset,
+                                   [](qint64 o, const Point & p) -> bool { return o < p.out; });
+        if (it == this->p_->points.begin()) {
+            throw ArchiveException("offset is not indexed");
+        }
+        point = *(it - 1);
+    }
+
+    QFile fin(path);
+    if (!fin.open(QIODevice::ReadOnly)) {
+        throw ArchiveException(fin.errorString());
+    }
+    Inflater inflater;
+    z_stream & zs = inflater.zs;
+    fin.seek(point.in - (point.bits ? 1 : 0));
+    if (point.bits) {
+        // the block begins in the middle of this byte
+        char c = 0;
+        if (!fin.getChar(&c)) {
+            throw ArchiveException("unexpected end of gzip stream");
+        }
+        inflatePrime(&zs, point.bits, static_cast<unsigned char>(c) >> (8 - point.bits));
+    }
+    inflateSetDictionary(&zs, reinterpret_cast<const Bytef *>(point.window.constData()), point.window.size());
+
+    QByteArray result(size, '\0');
+    QByteArray discard(CHUNK_SIZE, '\0');
+    QByteArray input;
+    qint64 skip = offset - point.out;
+    qint64 produced = 0;
+    bool raw = true;
+    while (skip > 0 || produced < size) {
+        if (skip > 0) {
+            zs.next_out = reinterpret_cast<Bytef *>(discard.data());
+            zs.avail_out = std::min<qint64>(skip, discard.size());
+        } else {
+            zs.next_out = reinterpret_cast<Bytef *>(result.data() + produced);
+            zs.avail_out = std::min<qint64>(size - produced, CHUNK_SIZE);
+        }
+        uInt before = zs.avail_out;
+        if (zs.avail_in == 0) {
+            input = fin.read(CHUNK_SIZE);
+            if (input.isEmpty()) {
+                throw ArchiveException("unexpected end of gzip stream");
+            }
+            zs.next_in = reinterpret_cast<Bytef *>(input.data());
+            zs.avail_in = input.size();
+        }
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        qint64 n = before - zs.avail_out;
+        if (skip > 0) {
+            skip -= n;
+        } else {
+            produced += n;
+        }
+        if (ret == Z_STREAM_END) {
+            // raw inflate leaves the trailer, another member follows
+            int trailer = raw ? 8 : 0;
+            while (trailer > 0) {
+                if (zs.avail_in == 0) {
+                    input = fin.read(CHUNK_SIZE);
+                    if (input.isEmpty()) {
+                        throw ArchiveException("unexpected end of gzip stream");
+                    }
+                    zs.next_in = reinterpret_cast<Bytef *>(input.data());
+                    zs.avail_in = input.size();
+                }
+                uInt step = std::min<uInt>(trailer, zs.avail_in);
+                zs.next_in += step;
+                zs.avail_in -= step;
+                trailer -= step;
+            }
+            inflateReset2(&zs, MAX_WBITS + 32);
+            raw = false;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            throw ArchiveException("broken gzip stream");
+        }
+    }
+    return result;
+}
+
+bool GzipIndex::load(const QString & key) {
+    const ExtractionCache & cache = ExtractionCache::instance();
+    if (!cache.contains(key)) {
+        return false;
+    }
+    QFile fin(cache.getDirectory(key).filePath(INDEX_NAME));
+    if (!fin.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&fin);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION) {
+        return false;
+    }
+
+    // the count is not trusted, a broken file must not allocate for it
+    if (count > fin.size() / MIN_POINT_SIZE) {
+        return false;
+    }
+    std::vector<Point> points;
+    points.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        Point point;
+        in >> point.out >> point.in >> point.bits >> point.window;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        points.push_back(point);
+    }
+    QMutexLocker locker(&this->p_->lock);
+    this->p_->points.swap(points);
+    return true;
+}
+
+void GzipIndex::save(const QString & key) const {
+    const ExtractionCache & cache = ExtractionCache::instance();
+    if (!cache.isPrepared()) {
+        return;
+    }
+    QSaveFile fout(cache.getDirectory(key).filePath(INDEX_NAME));
+    if (!fout.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&fout);
+    QMutexLocker locker(&this->p_->lock);
+    out << INDEX_MAGIC << INDEX_VERSION << static_cast<quint32>(this->p_->points.size());
+    for (const Point & point : this->p_->points) {
+        out << point.out << point.in << point.bits << point.window;
+    }
+    fout.commit();
+}
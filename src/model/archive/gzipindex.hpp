@@ -0,0 +1,82 @@
+/**
+ * @file gzipindex.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_GZIPINDEX_HPP
+#define KOMIX_MODEL_ARCHIVE_GZIPINDEX_HPP
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Access points of a gzip stream
+ *
+ * While the stream is read once, a snapshot of the deflate window is
+ * taken every few MiB of output. Later reads at any uncompressed offset
+ * inflate from the nearest access point only, so the cost of a seek
+ * does not depend on its position.
+ *
+ * Points are added by the reading thread and read from other threads,
+ * it is thread-safe.
+ */
+class GzipIndex {
+public:
+    GzipIndex();
+
+    /// Check if an access point is due at uncompressed offset @p out
+    bool isDue(qint64 out) const;
+    /**
+     * @brief Add an access point at a deflate block boundary
+     * @param out uncompressed offset
+     * @param in compressed offset of the first full byte of the block
+     * @param bits unused bits of the previous byte
+     * @param window the last 32 KiB of output
+     */
+    void addPoint(qint64 out, qint64 in, int bits, const QByteArray & window);
+
+    /**
+     * @brief Read uncompressed data
+     * @param path the gzip file
+     * @param offset uncompressed offset
+     * @param size bytes to read
+     * @throw KomiX::exception::ArchiveException on broken stream or
+     * unindexed offset
+     */
+    QByteArray read(const QString & path, qint64 offset, qint64 size) const;
+
+    /// Load from the extraction cache directory of archive @p key
+    bool load(const QString & key);
+    /// Save to the extraction cache directory of archive @p key
+    void save(const QString & key) const;
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file gzipreader.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "gzipreader.hpp"
+
+#include <QtCore/QtDebug>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class GzipReader::Private {
+public:
+    Private(std::shared_ptr<GzipIndex> index, const QString & path, qint64 offset, qint64 size);
+
+    std::shared_ptr<GzipIndex> index;
+    QString path;
+    qint64 offset;
+    qint64 size;
+};
+}
+}
+}
+
+using KomiX::model::archive::GzipReader;
+
+GzipReader::Private::Private(std::shared_ptr<GzipIndex> index, const QString & path, qint64 offset, qint64 size)
+    : index(index)
+    , path(path)
+    , offset(offset)
+    , size(size) {
+}
+
+GzipReader::GzipReader(std::shared_ptr<GzipIndex> index, const QString & path, qint64 offset, qint64 size)
+    : QObject()
+    , QRunnable()
+    , p_(new Private(index, path, offset, size)) {
+}
+
+void GzipReader::run() {
+    QByteArray data;
+    try {
+        data = this->p_->index->read(this->p_->path, this->p_->offset, this->p_->size);
+    } catch (KomiX::exception::ArchiveException & e) {
+        qWarning() << e.getMessage();
+    }
+    emit this->finished(data);
+}
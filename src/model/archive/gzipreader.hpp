@@ -0,0 +1,67 @@
+/**
+ * @file gzipreader.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_GZIPREADER_HPP
+#define KOMIX_MODEL_ARCHIVE_GZIPREADER_HPP
+
+#include "gzipindex.hpp"
+
+#include <QtCore/QObject>
+#include <QtCore/QRunnable>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Reads one page of a gzip stream through its access points
+ *
+ * Runs in a thread pool, so the view does not wait for the span before
+ * the page to be inflated.
+ */
+class GzipReader : public QObject, public QRunnable {
+    Q_OBJECT
+public:
+    /**
+     * @brief Constructor
+     * @param index access points of @p path
+     * @param path the gzip file
+     * @param offset uncompressed offset
+     * @param size bytes to read
+     */
+    GzipReader(std::shared_ptr<GzipIndex> index, const QString & path, qint64 offset, qint64 size);
+
+    virtual void run();
+
+signals:
+    /// @p data is empty if the stream is broken
+    void finished(const QByteArray & data);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
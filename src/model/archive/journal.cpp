@@ -0,0 +1,86 @@
+/**
+ * @file journal.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "extractioncache.hpp"
+#include "journal.hpp"
+
+#include <QtCore/QFile>
+
+namespace {
+
+const char * const JOURNAL_NAME = ".journal";
+const char * const COMPLETE_NAME = ".complete";
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+QSet<QString> loadJournal(const QString & key) {
+    QSet<QString> names;
+    const ExtractionCache & cache = ExtractionCache::instance();
+    if (!cache.contains(key)) {
+        return names;
+    }
+    QFile fin(cache.getDirectory(key).filePath(JOURNAL_NAME));
+    if (!fin.open(QIODevice::ReadOnly)) {
+        return names;
+    }
+    while (!fin.atEnd()) {
+        QByteArray line = fin.readLine();
+        // only whole lines were flushed before the crash
+        if (!line.endsWith('\n')) {
+            break;
+        }
+        line.chop(1);
+        names.insert(QString::fromUtf8(line));
+    }
+    return names;
+}
+
+void appendJournal(const QString & key, const QStringList & names) {
+    if (names.isEmpty()) {
+        return;
+    }
+    QByteArray lines;
+    foreach (QString name, names) {
+        lines.append(name.toUtf8()).append('\n');
+    }
+    QFile fout(ExtractionCache::instance().getDirectory(key).filePath(JOURNAL_NAME));
+    if (!fout.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+    fout.write(lines);
+    fout.flush();
+}
+
+bool isExtractionComplete(const QString & key) {
+    const ExtractionCache & cache = ExtractionCache::instance();
+    return cache.contains(key) && cache.getDirectory(key).exists(COMPLETE_NAME);
+}
+
+void markExtractionComplete(const QString & key) {
+    QFile fout(ExtractionCache::instance().getDirectory(key).filePath(COMPLETE_NAME));
+    fout.open(QIODevice::WriteOnly);
+}
+}
+}
+}
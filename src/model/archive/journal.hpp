@@ -0,0 +1,53 @@
+/**
+ * @file journal.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_JOURNAL_HPP
+#define KOMIX_MODEL_ARCHIVE_JOURNAL_HPP
+
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Load names of the entries of archive @p key which were extracted completely
+ *
+ * Files on disk which are not listed may be partial, e.g. the process
+ * was killed while writing them. A line torn by a crash is ignored.
+ */
+QSet<QString> loadJournal(const QString & key);
+/**
+ * @brief Record @p names of archive @p key as extracted completely
+ *
+ * Call it only after the files are written. The journal is stored in
+ * the extraction cache directory, so it is evicted along with them.
+ */
+void appendJournal(const QString & key, const QStringList & names);
+/// Check if every entry of archive @p key was extracted
+bool isExtractionComplete(const QString & key);
+/// Mark every entry of archive @p key as extracted
+void markExtractionComplete(const QString & key);
+}
+}
+} // end of namespace
+
+#endif
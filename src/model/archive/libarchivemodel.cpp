@@ -0,0 +1,447 @@
+/**
+ * @file libarchivemodel.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef KOMIX_HAVE_LIBARCHIVE
+
+#include "archive.hpp"
+#include "deferredfile.hpp"
+#include "extractioncache.hpp"
+#include "extractionscheduler.hpp"
+#include "global.hpp"
+#include "libarchivemodel_p.hpp"
+#include "tableofcontents.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QtDebug>
+#include <QtGui/QImageReader>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace {
+
+const int BLOCK_SIZE = 64 * 1024;
+/// pages passed this close to the requested one are kept
+const qint64 KEEP_BEHIND = 8;
+/// bytes of decoded pages kept for going back
+const qint64 KEEP_BUDGET = 64 * 1024 * 1024;
+
+std::shared_ptr<struct archive> openArchive(const QFileInfo & root) {
+    std::shared_ptr<struct archive> reader(archive_read_new(), archive_read_free);
+    if (!reader) {
+        throw KomiX::exception::ArchiveException("can not initialize libarchive");
+    }
+    archive_read_support_filter_all(reader.get());
+    archive_read_support_format_all(reader.get());
+    // multi-volume rar sets are opened as one archive
+    std::vector<QByteArray> paths;
+    foreach (QString volume, KomiX::model::archive::listVolumes(root)) {
+        paths.push_back(QFile::encodeName(volume));
+    }
+    std::vector<const char *> names;
+    for (const QByteArray & path : paths) {
+        names.push_back(path.constData());
+    }
+    names.push_back(nullptr);
+    if (archive_read_open_filenames(reader.get(), names.data(), BLOCK_SIZE) != ARCHIVE_OK) {
+        throw KomiX::exception::ArchiveException(QString::fromLocal8Bit(archive_error_string(reader.get())));
+    }
+    return reader;
+}
+
+QString getName(struct archive_entry * header) {
+    const char * utf8 = archive_entry_pathname_utf8(header);
+    if (utf8) {
+        return QString::fromUtf8(utf8);
+    }
+    const char * local = archive_entry_pathname(header);
+    return local ? QString::fromLocal8Bit(local) : QString();
+}
+
+bool isPage(struct archive_entry * header) {
+    return archive_entry_filetype(header) == AE_IFREG && KomiX::SupportedFormats().contains(QFileInfo(getName(header)).suffix().toLower());
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Forward cursor over the archive, shared by the model and its jobs
+ *
+ * The offset of an entry is its position in the archive. Pages decoded
+ * on the way to the requested one are kept within a budget, so going
+ * back a few pages does not decode the archive from its beginning again.
+ */
+class LibArchiveSource {
+public:
+    explicit LibArchiveSource(const QFileInfo & root);
+
+    std::vector<Entry> list();
+    QByteArray read(const Entry & entry);
+    bool find(qint64 offset, QByteArray & data);
+
+private:
+    QByteArray readData();
+    void keep(qint64 offset, const QByteArray & data);
+
+    QFileInfo root;
+    QMutex lock;
+    std::shared_ptr<struct archive> reader;
+    qint64 position;
+    // guards kept pages only, never held while decoding
+    QMutex keptLock;
+    QHash<qint64, QByteArray> kept;
+    std::deque<qint64> keptOrder;
+    qint64 keptSize;
+};
+}
+}
+}
+
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::LibArchiveLister;
+using KomiX::model::archive::LibArchiveModel;
+using KomiX::model::archive::LibArchiveReader;
+using KomiX::model::archive::LibArchiveSource;
+using KomiX::exception::ArchiveException;
+
+LibArchiveSource::LibArchiveSource(const QFileInfo & root)
+    : root(root)
+    , lock()
+    , reader()
+    , position(0)
+    , keptLock()
+    , kept()
+    , keptOrder()
+    , keptSize(0) {
+}
+
+std::vector<Entry> LibArchiveSource::list() {
+    std::shared_ptr<struct archive> reader = openArchive(this->root);
+    std::vector<Entry> entries;
+    struct archive_entry * header = nullptr;
+    for (qint64 index = 0;; ++index) {
+        int ret = archive_read_next_header(reader.get(), &header);
+        if (ret == ARCHIVE_EOF) {
+            break;
+        } else if (ret != ARCHIVE_OK && ret != ARCHIVE_WARN) {
+            throw ArchiveException(QString::fromLocal8Bit(archive_error_string(reader.get())));
+        }
+        if (!isPage(header)) {
+            continue;
+        }
+        if (archive_entry_is_encrypted(header)) {
+            throw ArchiveException("encrypted archive is not supported");
+        }
+        Entry entry;
+        entry.name = getName(header);
+        entry.offset = index;
+        entry.size = archive_entry_size(header);
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry & l, const Entry & r) -> bool {
+        return QString::compare(l.name, r.name, Qt::CaseInsensitive) < 0;
+    });
+    return entries;
+}
+
+QByteArray LibArchiveSource::read(const Entry & entry) {
+    QMutexLocker locker(&this->lock);
+    QByteArray data;
+    // may be passed by the job before this one
+    if (this->find(entry.offset, data)) {
+        return data;
+    }
+    if (!this->reader || entry.offset < this->position) {
+        // can not go backward, start over
+        this->reader.reset();
+        this->position = 0;
+        this->reader = openArchive(this->root);
+    }
+
+    struct archive_entry * header = nullptr;
+    while (this->position <= entry.offset) {
+        int ret = archive_read_next_header(this->reader.get(), &header);
+        if (ret != ARCHIVE_OK && ret != ARCHIVE_WARN) {
+            QString message = (ret == ARCHIVE_EOF) ? QString("archive was changed") : QString::fromLocal8Bit(archive_error_string(this->reader.get()));
+            this->reader.reset();
+            throw ArchiveException(message);
+        }
+        qint64 offset = this->position++;
+        if (offset < entry.offset && entry.offset - offset <= KEEP_BEHIND && isPage(header)) {
+            // likely the next one when paging back
+            this->keep(offset, this->readData());
+        }
+    }
+    data = this->readData();
+    this->keep(entry.offset, data);
+    return data;
+}
+
+bool LibArchiveSource::find(qint64 offset, QByteArray & data) {
+    QMutexLocker locker(&this->keptLock);
+    auto it = this->kept.find(offset);
+    if (it == this->kept.end()) {
+        return false;
+    }
+    data = it.value();
+    return true;
+}
+
+QByteArray LibArchiveSource::readData() {
+    QByteArray data;
+    QByteArray chunk(BLOCK_SIZE, '\0');
+    qint64 n = 0;
+    while ((n = archive_read_data(this->reader.get(), chunk.data(), chunk.size())) > 0) {
+        data.append(chunk.constData(), n);
+    }
+    if (n < 0) {
+        QString message = QString::fromLocal8Bit(archive_error_string(this->reader.get()));
+        this->reader.reset();
+        throw ArchiveException(message);
+    }
+    return data;
+}
+
+void LibArchiveSource::keep(qint64 offset, const QByteArray & data) {
+    if (data.size() > KEEP_BUDGET) {
+        return;
+    }
+    QMutexLocker locker(&this->keptLock);
+    if (this->kept.contains(offset)) {
+        return;
+    }
+    while (!this->keptOrder.empty() && this->keptSize + data.size() > KEEP_BUDGET) {
+        // oldest first
+        this->keptSize -= this->kept.take(this->keptOrder.front()).size();
+        this->keptOrder.pop_front();
+    }
+    this->kept.insert(offset, data);
+    this->keptOrder.push_back(offset);
+    this->keptSize += data.size();
+}
+
+LibArchiveLister::LibArchiveLister(std::shared_ptr<LibArchiveSource> source, std::shared_ptr<std::vector<Entry>> entries)
+    : QObject()
+    , QRunnable()
+    , source(source)
+    , entries(entries) {
+}
+
+void LibArchiveLister::run() {
+    try {
+        *this->entries = this->source->list();
+        emit this->finished(true, QString());
+    } catch (ArchiveException & e) {
+        emit this->finished(false, e.getMessage());
+    }
+}
+
+LibArchiveReader::LibArchiveReader(std::shared_ptr<LibArchiveSource> source, int row, const Entry & entry)
+    : QObject()
+    , QRunnable()
+    , source(source)
+    , row(row)
+    , entry(entry) {
+}
+
+void LibArchiveReader::run() {
+    QByteArray data;
+    try {
+        data = this->source->read(this->entry);
+    } catch (ArchiveException & e) {
+        qWarning() << e.getMessage();
+    }
+    if (this->entry.width == 0 && this->entry.height == 0 && !data.isEmpty()) {
+        // only parses the image header
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QSize size = QImageReader(&buffer).size();
+        if (size.isValid()) {
+            emit this->measured(this->row, size.width(), size.height());
+        }
+    }
+    emit this->finished(data);
+}
+
+LibArchiveModel::Private::Private(LibArchiveModel * owner, const QFileInfo & root)
+    : QObject()
+    , owner(owner)
+    , root(root)
+    , key(getArchiveKey(root))
+    , entries()
+    , dirty(false)
+    , source(new LibArchiveSource(root))
+    , listing(new std::vector<Entry>) {
+    ExtractionCache::instance().acquire(this->key);
+}
+
+LibArchiveModel::Private::~Private() {
+    ExtractionScheduler::instance().cancel(this);
+    if (this->dirty) {
+        // remember image sizes found during this session
+        saveTableOfContents(this->key, "libarchive", this->entries);
+    }
+    ExtractionCache::instance().release(this->key);
+}
+
+void LibArchiveModel::Private::setEntries(const std::vector<Entry> & entries) {
+    this->owner->beginResetModel();
+    this->entries = entries;
+    this->owner->endResetModel();
+    emit this->ready();
+    emit this->finished();
+}
+
+QIODevice * LibArchiveModel::Private::open(int row) {
+    const Entry & entry = this->entries[row];
+    QByteArray data;
+    if (this->source->find(entry.offset, data)) {
+        // decoded already, no need to wait
+        QBuffer * buffer = new QBuffer;
+        buffer->setData(data);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+    DeferredFile * device = new DeferredFile(QString());
+    LibArchiveReader * reader = new LibArchiveReader(this->source, row, entry);
+    device->connect(reader, SIGNAL(finished(const QByteArray &)), SLOT(complete(const QByteArray &)));
+    this->connect(reader, SIGNAL(measured(int, int, int)), SLOT(onMeasured(int, int, int)));
+    // owned by the loader, outlives the model
+    ExtractionScheduler::instance().start(reader, ExtractionScheduler::Foreground, nullptr);
+    return device;
+}
+
+void LibArchiveModel::Private::onListed(bool ok, const QString & message) {
+    if (!ok) {
+        qWarning() << message;
+        emit this->error(message);
+        return;
+    }
+    saveTableOfContents(this->key, "libarchive", *this->listing);
+    this->setEntries(*this->listing);
+    this->listing->clear();
+}
+
+void LibArchiveModel::Private::onMeasured(int row, int width, int height) {
+    if (row < 0 || row >= static_cast<int>(this->entries.size())) {
+        return;
+    }
+    this->entries[row].width = width;
+    this->entries[row].height = height;
+    this->dirty = true;
+}
+
+bool LibArchiveModel::IsSupported(const QString & name) {
+    return name.endsWith(".7z") || name.endsWith(".rar") || name.endsWith(".tar");
+}
+
+LibArchiveModel::LibArchiveModel(const QFileInfo & root)
+    : FileModel()
+    , p_(new Private(this, root)) {
+    this->connect(this->p_.get(), SIGNAL(error(const QString &)), SIGNAL(error(const QString &)));
+    this->connect(this->p_.get(), SIGNAL(ready()), SIGNAL(ready()));
+    this->connect(this->p_.get(), SIGNAL(finished()), SIGNAL(finished()));
+}
+
+void LibArchiveModel::doInitialize() {
+    std::vector<Entry> entries;
+    if (loadTableOfContents(this->p_->key, "libarchive", entries)) {
+        // listed before, no need to read the headers
+        this->p_->setEntries(entries);
+        return;
+    }
+    // reading every header may decode the whole archive
+    LibArchiveLister * lister = new LibArchiveLister(this->p_->source, this->p_->listing);
+    this->p_->connect(lister, SIGNAL(finished(bool, const QString &)), SLOT(onListed(bool, const QString &)));
+    ExtractionScheduler::instance().start(lister, ExtractionScheduler::Foreground, this->p_.get());
+}
+
+QModelIndex LibArchiveModel::index(const QUrl & url) const {
+    QString name = QFileInfo(url.toLocalFile()).fileName();
+    for (int row = 0; row < this->rowCount(); ++row) {
+        if (QFileInfo(this->p_->entries[row].name).fileName() == name) {
+            return createIndex(row, 0, row);
+        }
+    }
+    return QModelIndex();
+}
+
+QModelIndex LibArchiveModel::index(int row, int column, const QModelIndex & parent) const {
+    if (!parent.isValid()) {
+        // query from root
+        if (column == 0 && row >= 0 && row < this->rowCount()) {
+            return createIndex(row, 0, row);
+        } else {
+            return QModelIndex();
+        }
+    } else {
+        // other node has no child
+        return QModelIndex();
+    }
+}
+
+QModelIndex LibArchiveModel::parent(const QModelIndex & /*child*/) const {
+    // flat list, every node is a child of root
+    return QModelIndex();
+}
+
+int LibArchiveModel::rowCount(const QModelIndex & parent) const {
+    if (!parent.isValid()) {
+        // root row size
+        return this->p_->entries.size();
+    } else {
+        // others are leaf
+        return 0;
+    }
+}
+
+int LibArchiveModel::columnCount(const QModelIndex & /*parent*/) const {
+    return 1;
+}
+
+QVariant LibArchiveModel::data(const QModelIndex & index, int role) const {
+    if (!index.isValid() || index.column() != 0 || index.row() < 0 || index.row() >= this->rowCount()) {
+        return QVariant();
+    }
+    const Entry & entry = this->p_->entries[index.row()];
+    switch (role) {
+        case Qt::DisplayRole:
+            return entry.name;
+        case Qt::UserRole: {
+            QIODevice * fin = this->p_->open(index.row());
+            return QVariant::fromValue(fin);
+        }
+        default:
+            return QVariant();
+    }
+}
+
+#endif
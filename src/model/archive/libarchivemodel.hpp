@@ -0,0 +1,87 @@
+/**
+ * @file libarchivemodel.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_LIBARCHIVEMODEL_HPP
+#define KOMIX_MODEL_ARCHIVE_LIBARCHIVEMODEL_HPP
+
+#include "filemodel.hpp"
+
+#include <QtCore/QFileInfo>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief The model to read archives in-process by libarchive
+ *
+ * Each image entry is a row, and it is decompressed on a worker thread
+ * when requested. Entries are read forward, so paging in order never
+ * reopens the archive, and the last pages decoded are kept in memory for
+ * paging back. The table of contents is cached like ZipModel.
+ * Supported file formats: 7z, rar, tar, and rar volume sets.
+ *
+ * Only built when libarchive is found, and only used when 7-Zip is not
+ * installed: ArchiveModel extracts solid blocks once instead of decoding
+ * them again for every page.
+ */
+class LibArchiveModel : public FileModel {
+public:
+    /**
+     * @brief check if @p name can be opened by this model
+     * @param name lower case file name
+     */
+    static bool IsSupported(const QString & name);
+
+    /**
+     * @brief Constructor with given fileinfo
+     * @param root archive file
+     *
+     * The archive is listed on initialization, errors are reported by
+     * the error signal.
+     */
+    explicit LibArchiveModel(const QFileInfo & root);
+
+    /// Overrides from FileModel
+    virtual QModelIndex index(const QUrl & url) const;
+
+    /// Overrides from FileModel
+    virtual QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual QModelIndex parent(const QModelIndex & child) const;
+    /// Overrides from FileModel
+    virtual int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual int columnCount(const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+protected:
+    virtual void doInitialize();
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
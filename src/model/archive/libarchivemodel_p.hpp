@@ -0,0 +1,110 @@
+/**
+ * @file libarchivemodel_p.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_LIBARCHIVEMODEL_P_HPP
+#define KOMIX_MODEL_ARCHIVE_LIBARCHIVEMODEL_P_HPP
+
+#ifdef KOMIX_HAVE_LIBARCHIVE
+
+#include "entry.hpp"
+#include "libarchivemodel.hpp"
+
+#include <QtCore/QRunnable>
+
+#include <memory>
+#include <vector>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class LibArchiveSource;
+
+/// lists image entries on a worker thread
+class LibArchiveLister : public QObject, public QRunnable {
+    Q_OBJECT
+public:
+    LibArchiveLister(std::shared_ptr<LibArchiveSource> source, std::shared_ptr<std::vector<Entry>> entries);
+
+    virtual void run();
+
+signals:
+    void finished(bool ok, const QString & message);
+
+private:
+    std::shared_ptr<LibArchiveSource> source;
+    std::shared_ptr<std::vector<Entry>> entries;
+};
+
+/// decodes one page on a worker thread
+class LibArchiveReader : public QObject, public QRunnable {
+    Q_OBJECT
+public:
+    LibArchiveReader(std::shared_ptr<LibArchiveSource> source, int row, const Entry & entry);
+
+    virtual void run();
+
+signals:
+    /// @p data is empty if the entry can not be read
+    void finished(const QByteArray & data);
+    void measured(int row, int width, int height);
+
+private:
+    // keeps the archive readable even if the model is gone
+    std::shared_ptr<LibArchiveSource> source;
+    int row;
+    Entry entry;
+};
+
+class LibArchiveModel::Private : public QObject {
+    Q_OBJECT
+public:
+    Private(LibArchiveModel * owner, const QFileInfo & root);
+    virtual ~Private();
+
+    void setEntries(const std::vector<Entry> & entries);
+    QIODevice * open(int row);
+
+public slots:
+    void onListed(bool ok, const QString & message);
+    void onMeasured(int row, int width, int height);
+
+signals:
+    void ready();
+    void finished();
+    void error(const QString &);
+
+public:
+    LibArchiveModel * owner;
+    QFileInfo root;
+    QString key;
+    std::vector<Entry> entries;
+    bool dirty;
+    std::shared_ptr<LibArchiveSource> source;
+    // filled by the lister
+    std::shared_ptr<std::vector<Entry>> listing;
+};
+}
+}
+}
+
+#endif
+
+#endif
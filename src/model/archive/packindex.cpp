@@ -0,0 +1,81 @@
+/**
+ * @file packindex.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "packindex.hpp"
+#include "ziparchive.hpp"
+
+#include <QtCore/QDataStream>
+
+namespace {
+
+const quint32 PACK_MAGIC = 0x4b58504b;
+const quint32 PACK_VERSION = 1;
+/// an empty name, offset, size, CRC-32, width and height
+const int MIN_RECORD_SIZE = 4 + 8 + 8 + 4 + 4 + 4;
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+const char * const PACK_INDEX_NAME = ".komix-index";
+
+QByteArray savePackIndex(const std::vector<Entry> & entries) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << PACK_MAGIC << PACK_VERSION << static_cast<quint32>(entries.size());
+    // fixed width fields only, besides the name
+    for (const Entry & entry : entries) {
+        out << entry.name << entry.offset << entry.size << entry.crc32 << entry.width << entry.height;
+    }
+    return data;
+}
+
+bool loadPackIndex(const QByteArray & data, std::vector<Entry> & entries) {
+    QDataStream in(data);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != PACK_MAGIC || version != PACK_VERSION) {
+        return false;
+    }
+    // the index is stored in the archive, do not trust the count
+    if (count > static_cast<quint32>(data.size() / MIN_RECORD_SIZE)) {
+        return false;
+    }
+
+    std::vector<Entry> tmp;
+    tmp.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        Entry entry;
+        in >> entry.name >> entry.offset >> entry.size >> entry.crc32 >> entry.width >> entry.height;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        entry.packedSize = entry.size;
+        entry.method = ZipArchive::Stored;
+        tmp.push_back(entry);
+    }
+    entries.swap(tmp);
+    return true;
+}
+}
+}
+}
@@ -0,0 +1,54 @@
+/**
+ * @file packindex.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_PACKINDEX_HPP
+#define KOMIX_MODEL_ARCHIVE_PACKINDEX_HPP
+
+#include "entry.hpp"
+
+#include <QtCore/QByteArray>
+
+#include <vector>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/// Name of the first entry of archives written by komix-repack
+extern const char * const PACK_INDEX_NAME;
+
+/**
+ * @brief Serialize the pages of a repacked archive
+ *
+ * Entries are stored and in reading order. The size of the result only
+ * depends on entry names, so a writer can reserve room for the index
+ * before offsets and checksums are known.
+ */
+QByteArray savePackIndex(const std::vector<Entry> & entries);
+/**
+ * @brief Parse an index written by savePackIndex()
+ * @return false if @p data is not a readable index
+ */
+bool loadPackIndex(const QByteArray & data, std::vector<Entry> & entries);
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file tableofcontents.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "extractioncache.hpp"
+#include "tableofcontents.hpp"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+
+namespace {
+
+const quint32 TOC_MAGIC = 0x4b585443;
+const quint32 TOC_VERSION = 3;
+const char * const TOC_NAME = ".toc";
+/// two empty names and the fixed width fields
+const qint64 MIN_ENTRY_SIZE = 4 + 8 + 8 + 8 + 4 + 4 + 4 + 4 + 4 + 4;
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+bool loadTableOfContents(const QString & key, const QString & backend, std::vector<Entry> & entries) {
+    const ExtractionCache & cache = ExtractionCache::instance();
+    if (!cache.contains(key)) {
+        return false;
+    }
+    QFile fin(cache.getDirectory(key).filePath(TOC_NAME));
+    if (!fin.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&fin);
+    quint32 magic = 0, version = 0, count = 0;
+    QString writer;
+    in >> magic >> version >> writer >> count;
+    if (magic != TOC_MAGIC || version != TOC_VERSION || writer != backend) {
+        return false;
+    }
+
+    // a broken file must not allocate for its count, it is listed again
+    if (in.status() != QDataStream::Ok || count > fin.size() / MIN_ENTRY_SIZE) {
+        return false;
+    }
+    std::vector<Entry> tmp;
+    tmp.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        Entry entry;
+        qint32 method = 0;
+        in >> entry.name >> entry.offset >> entry.packedSize >> entry.size >> method >> entry.crc32 >> entry.width >> entry.height >> entry.container >> entry.block;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        entry.method = method;
+        tmp.push_back(entry);
+    }
+    entries.swap(tmp);
+    return true;
+}
+
+void saveTableOfContents(const QString & key, const QString & backend, const std::vector<Entry> & entries) {
+    const ExtractionCache & cache = ExtractionCache::instance();
+    if (!cache.isPrepared()) {
+        return;
+    }
+    QSaveFile fout(cache.getDirectory(key).filePath(TOC_NAME));
+    if (!fout.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&fout);
+    out << TOC_MAGIC << TOC_VERSION << backend << static_cast<quint32>(entries.size());
+    for (const Entry & entry : entries) {
+        out << entry.name << entry.offset << entry.packedSize << entry.size << static_cast<qint32>(entry.method) << entry.crc32 << entry.width << entry.height
+            << entry.container << entry.block;
+    }
+    fout.commit();
+}
+}
+}
+}
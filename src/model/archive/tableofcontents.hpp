@@ -0,0 +1,51 @@
+/**
+ * @file tableofcontents.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_TABLEOFCONTENTS_HPP
+#define KOMIX_MODEL_ARCHIVE_TABLEOFCONTENTS_HPP
+
+#include "entry.hpp"
+
+#include <vector>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Load cached table of contents of archive @p key
+ * @param key archive identity, see getArchiveKey()
+ * @param backend the backend which wrote it, because fields are backend specific
+ * @param entries receives the entries
+ * @return false if not cached, written by another backend, or unreadable
+ */
+bool loadTableOfContents(const QString & key, const QString & backend, std::vector<Entry> & entries);
+/**
+ * @brief Cache table of contents of archive @p key
+ *
+ * It is stored in the extraction cache directory of the archive, so it
+ * is evicted along with extracted files.
+ */
+void saveTableOfContents(const QString & key, const QString & backend, const std::vector<Entry> & entries);
+}
+}
+} // end of namespace
+
+#endif
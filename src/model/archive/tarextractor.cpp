@@ -0,0 +1,199 @@
+/**
+ * @file tarextractor.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "contentstore.hpp"
+#include "extractioncache.hpp"
+#include "memorystore.hpp"
+#include "tableofcontents.hpp"
+#include "tarextractor.hpp"
+#include "tarreader.hpp"
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include <limits>
+#include <vector>
+
+namespace {
+
+const qint64 CHUNK_SIZE = 256 * 1024;
+
+/// reject absolute paths and paths escaping the cache directory
+QString sanitize(const QString & name) {
+    QString path = QDir::cleanPath(QDir::fromNativeSeparators(name));
+    if (path.isEmpty() || QDir::isAbsolutePath(path) || path == ".." || path.startsWith("../")) {
+        return QString();
+    }
+    return path;
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class TarExtractor::Private {
+public:
+    Private(const QString & path, CompressedDevice::Format format, const QString & key, const QStringList & formats,
+            std::shared_ptr<QAtomicInt> canceled, std::shared_ptr<GzipIndex> index, const QSet<QString> & done);
+
+    bool write(TarReader & reader, const QString & path, qint64 size);
+    void writeFile(TarReader & reader, const QString & path, const QByteArray & head);
+
+    QString path;
+    CompressedDevice::Format format;
+    QString key;
+    QStringList formats;
+    std::shared_ptr<QAtomicInt> canceled;
+    std::shared_ptr<GzipIndex> index;
+    QSet<QString> done;
+};
+}
+}
+}
+
+using KomiX::model::archive::TarExtractor;
+using KomiX::exception::ArchiveException;
+
+TarExtractor::Private::Private(const QString & path, CompressedDevice::Format format, const QString & key,
+                               const QStringList & formats, std::shared_ptr<QAtomicInt> canceled,
+                               std::shared_ptr<GzipIndex> index, const QSet<QString> & done)
+    : path(path)
+    , format(format)
+    , key(key)
+    , formats(formats)
+    , canceled(canceled)
+    , index(index)
+    , done(done) {
+}
+
+bool TarExtractor::Private::write(TarReader & reader, const QString & path, qint64 size) {
+    MemoryStore & memory = MemoryStore::instance();
+    qint64 budget = memory.getBudget();
+    if (budget <= 0 || size > budget || size > std::numeric_limits<int>::max()) {
+        this->writeFile(reader, path, QByteArray());
+        return false;
+    }
+    QByteArray data(size, '\0');
+    qint64 read = 0;
+    qint64 n = 0;
+    while (read < size && (n = reader.read(data.data() + read, size - read)) > 0) {
+        read += n;
+    }
+    data.truncate(read);
+    if (memory.store(path, data)) {
+        return true;
+    }
+    // over budget, spill to disk
+    this->writeFile(reader, path, data);
+    return false;
+}
+
+// @p head was already read from @p reader
+void TarExtractor::Private::writeFile(TarReader & reader, const QString & path, const QByteArray & head) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    // readers never see a partial page
+    QString partial = path + ".part";
+    QFile fout(partial);
+    if (!fout.open(QIODevice::WriteOnly)) {
+        throw ArchiveException(fout.errorString());
+    }
+    if (fout.write(head) != head.size()) {
+        throw ArchiveException(fout.errorString());
+    }
+    QByteArray chunk(CHUNK_SIZE, '\0');
+    qint64 n = 0;
+    while ((n = reader.read(chunk.data(), chunk.size())) > 0) {
+        if (fout.write(chunk.constData(), n) != n) {
+            throw ArchiveException(fout.errorString());
+        }
+    }
+    fout.close();
+    QFile::remove(path);
+    if (!QFile::rename(partial, path)) {
+        throw ArchiveException(QString("can not write %1").arg(path));
+    }
+}
+
+TarExtractor::TarExtractor(const QString & path, CompressedDevice::Format format, const QString & key,
+                           const QStringList & formats, std::shared_ptr<QAtomicInt> canceled,
+                           std::shared_ptr<GzipIndex> index, const QSet<QString> & done)
+    : QObject()
+    , QRunnable()
+    , p_(new Private(path, format, key, formats, canceled, index, done)) {
+}
+
+void TarExtractor::run() {
+    try {
+        std::shared_ptr<QFile> fin(new QFile(this->p_->path));
+        if (!fin->open(QIODevice::ReadOnly)) {
+            throw ArchiveException(fin->errorString());
+        }
+        CompressedDevice device(fin, this->p_->format);
+        if (this->p_->index) {
+            device.setIndex(this->p_->index);
+        }
+        device.open(QIODevice::ReadOnly);
+        TarReader reader(&device);
+        QDir dir = ExtractionCache::instance().getDirectory(this->p_->key);
+
+        std::vector<Entry> entries;
+        bool inMemory = false;
+        Entry entry;
+        while (reader.next(entry)) {
+            if (this->p_->canceled->load() != 0) {
+                emit this->finished(false, QString("canceled"));
+                return;
+            }
+            entry.name = sanitize(entry.name);
+            if (entry.name.isEmpty() || !this->p_->formats.contains(QFileInfo(entry.name).suffix().toLower())) {
+                continue;
+            }
+            entries.push_back(entry);
+            if (this->p_->index) {
+                emit this->indexed(entry.name, entry.offset, entry.size);
+                continue;
+            }
+            if (this->p_->done.contains(entry.name)) {
+                // written by the run which was cut short
+                emit this->extracted(entry.name);
+                continue;
+            }
+            if (this->p_->write(reader, dir.filePath(entry.name), entry.size)) {
+                inMemory = true;
+            } else {
+                ContentStore::instance().adopt(dir, entry.name);
+            }
+            emit this->extracted(entry.name);
+        }
+        if (this->p_->index) {
+            this->p_->index->save(this->p_->key);
+            saveTableOfContents(this->p_->key, "gzip", entries);
+        } else if (!inMemory) {
+            // pages in memory are gone with this session, extract again next time
+            saveTableOfContents(this->p_->key, "tar", entries);
+        }
+        emit this->finished(true, QString());
+    } catch (ArchiveException & e) {
+        emit this->finished(false, e.getMessage());
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * @file tarextractor.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_TAREXTRACTOR_HPP
+#define KOMIX_MODEL_ARCHIVE_TAREXTRACTOR_HPP
+
+#include "compresseddevice.hpp"
+#include "gzipindex.hpp"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QDir>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Extracts images of a compressed tarball in one pass
+ *
+ * Runs in a thread pool. The tarball is decompressed in memory and only
+ * images are written, so the uncompressed tarball never touches the
+ * disk. Table of contents is saved as backend "tar" on success.
+ *
+ * With a GzipIndex, nothing is written: entries are only reported, and
+ * access points are recorded so pages can be read from the tarball
+ * directly. Table of contents is saved as backend "gzip" along with the
+ * index.
+ *
+ * Pages written completely by an earlier run are skipped, only reported.
+ */
+class TarExtractor : public QObject, public QRunnable {
+    Q_OBJECT
+public:
+    /**
+     * @brief Constructor
+     * @param path compressed tarball
+     * @param format compression format
+     * @param key archive identity, see getArchiveKey()
+     * @param formats image suffixes to extract
+     * @param canceled stop as soon as possible when it is not zero
+     * @param index records access points instead of writing pages, may be null
+     * @param done pages on disk already, see loadJournal()
+     */
+    TarExtractor(const QString & path, CompressedDevice::Format format, const QString & key, const QStringList & formats,
+                 std::shared_ptr<QAtomicInt> canceled, std::shared_ptr<GzipIndex> index, const QSet<QString> & done);
+
+    virtual void run();
+
+signals:
+    /// @p name is completely written, relative to the cache directory
+    void extracted(const QString & name);
+    /// @p name is at @p offset of the uncompressed tarball
+    void indexed(const QString & name, qint64 offset, qint64 size);
+    void finished(bool ok, const QString & message);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,255 @@
+/**
+ * @file tarreader.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "tarreader.hpp"
+
+#include <algorithm>
+
+namespace {
+
+const qint64 BLOCK_SIZE = 512;
+
+qint64 parseNumber(const char * field, int length) {
+    const unsigned char * p = reinterpret_cast<const unsigned char *>(field);
+    qint64 value = 0;
+    if (p[0] & 0x80) {
+        // GNU base-256 extension for large files, it must fit in 63 bits
+        if (p[0] & 0x7F) {
+            return -1;
+        }
+        for (int i = 1; i < length - 8; ++i) {
+            if (p[i] != 0) {
+                return -1;
+            }
+        }
+        if (p[length - 8] & 0x80) {
+            return -1;
+        }
+        for (int i = length - 8; i < length; ++i) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+    int i = 0;
+    while (i < length && (p[i] == ' ' || p[i] == '\0')) {
+        ++i;
+    }
+    for (; i < length && p[i] >= '0' && p[i] <= '7'; ++i) {
+        value = (value << 3) | (p[i] - '0');
+    }
+    return value;
+}
+
+QByteArray parseString(const char * field, int length) {
+    return QByteArray(field, qstrnlen(field, length));
+}
+
+bool verify(const QByteArray & header) {
+    // checksum field is counted as spaces
+    qint64 sum = 0;
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    return sum == parseNumber(header.constData() + 148, 8);
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class TarReader::Private {
+public:
+    explicit Private(QIODevice * device);
+
+    void readFully(char * data, qint64 size);
+    QByteArray readContent(qint64 size);
+    void skip(qint64 size);
+
+    QIODevice * device;
+    qint64 position;
+    qint64 remaining;
+    qint64 padding;
+};
+}
+}
+}
+
+using KomiX::model::archive::TarReader;
+using KomiX::exception::ArchiveException;
+
+TarReader::Private::Private(QIODevice * device)
+    : device(device)
+    , position(0)
+    , remaining(0)
+    , padding(0) {
+}
+
+void TarReader::Private::readFully(char * data, qint64 size) {
+    while (size > 0) {
+        qint64 n = this->device->read(data, size);
+        if (n <= 0) {
+            throw ArchiveException(n < 0 ? this->device->errorString() : QString("unexpected end of tar archive"));
+        }
+        data += n;
+        size -= n;
+        this->position += n;
+    }
+}
+
+QByteArray TarReader::Private::readContent(qint64 size) {
+    if (size < 0 || size > 0x100000) {
+        throw ArchiveException("broken tar extended header");
+    }
+    QByteArray content(size, '\0');
+    this->readFully(content.data(), size);
+    this->skip((BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE);
+    return content;
+}
+
+void TarReader::Private::skip(qint64 size) {
+    char buffer[BLOCK_SIZE * 8];
+    while (size > 0) {
+        qint64 n = std::min<qint64>(size, sizeof(buffer));
+        this->readFully(buffer, n);
+        size -= n;
+    }
+}
+
+TarReader::TarReader(QIODevice * device)
+    : p_(new Private(device)) {
+}
+
+bool TarReader::next(Entry & entry) {
+    this->p_->skip(this->p_->remaining + this->p_->padding);
+    this->p_->remaining = 0;
+    this->p_->padding = 0;
+
+    QString longName;
+    QString paxPath;
+    qint64 paxSize = -1;
+    QByteArray header(BLOCK_SIZE, '\0');
+    for (;;) {
+        qint64 n = this->p_->device->read(header.data(), BLOCK_SIZE);
+        if (n == 0) {
+            // some writers omit the trailing zero blocks
+            return false;
+        } else if (n < 0) {
+            throw ArchiveException(this->p_->device->errorString());
+        }
+        this->p_->position += n;
+        this->p_->readFully(header.data() + n, BLOCK_SIZE - n);
+        if (header.count('\0') == BLOCK_SIZE) {
+            return false;
+        }
+        if (!verify(header)) {
+            throw ArchiveException("broken tar header");
+        }
+
+        const char * h = header.constData();
+        char type = h[156];
+        qint64 size = parseNumber(h + 124, 12);
+        if (size < 0) {
+            throw ArchiveException("broken tar header");
+        }
+
+        if (type == 'L') {
+            // GNU long name of the next entry
+            longName = QString::fromLocal8Bit(parseString(this->p_->readContent(size).constData(), size));
+            continue;
+        }
+        if (type == 'x') {
+            // pax records: "<length> <key>=<value>\n"
+            QByteArray records = this->p_->readContent(size);
+            int begin = 0;
+            while (begin < records.size()) {
+                int space = records.indexOf(' ', begin);
+                if (space < 0) {
+                    break;
+                }
+                int length = records.mid(begin, space - begin).toInt();
+                if (length <= 0 || begin + length > records.size()) {
+                    break;
+                }
+                QByteArray record = records.mid(space + 1, begin + length - space - 2);
+                int eq = record.indexOf('=');
+                if (eq > 0) {
+                    QByteArray key = record.left(eq);
+                    if (key == "path") {
+                        paxPath = QString::fromUtf8(record.mid(eq + 1));
+                    } else if (key == "size") {
+                        paxSize = record.mid(eq + 1).toLongLong();
+                    }
+                }
+                begin += length;
+            }
+            continue;
+        }
+        if (paxSize >= 0) {
+            size = paxSize;
+        }
+        qint64 padding = (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+        if (type != '0' && type != '\0' && type != '7') {
+            // directories, links, devices and global headers carry no page
+            this->p_->skip(size + padding);
+            longName.clear();
+            paxPath.clear();
+            paxSize = -1;
+            continue;
+        }
+
+        QString name;
+        if (!paxPath.isEmpty()) {
+            name = paxPath;
+        } else if (!longName.isEmpty()) {
+            name = longName;
+        } else {
+            name = QString::fromLocal8Bit(parseString(h, 100));
+            // POSIX ustar splits long names, GNU uses the field otherwise
+            if (qstrncmp(h + 257, "ustar", 6) == 0) {
+                QByteArray prefix = parseString(h + 345, 155);
+                if (!prefix.isEmpty()) {
+                    name = QString::fromLocal8Bit(prefix) + "/" + name;
+                }
+            }
+        }
+
+        entry = Entry();
+        entry.name = name;
+        entry.offset = this->p_->position;
+        entry.packedSize = size;
+        entry.size = size;
+        this->p_->remaining = size;
+        this->p_->padding = padding;
+        return true;
+    }
+}
+
+qint64 TarReader::read(char * data, qint64 maxSize) {
+    qint64 n = std::min(maxSize, this->p_->remaining);
+    if (n <= 0) {
+        return 0;
+    }
+    this->p_->readFully(data, n);
+    this->p_->remaining -= n;
+    return n;
+}
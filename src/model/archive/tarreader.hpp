@@ -0,0 +1,73 @@
+/**
+ * @file tarreader.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_TARREADER_HPP
+#define KOMIX_MODEL_ARCHIVE_TARREADER_HPP
+
+#include "entry.hpp"
+
+#include <QtCore/QIODevice>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Forward only tar reader
+ *
+ * Reads ustar, GNU long names and pax paths from a sequential device,
+ * so a compressed tarball can be read in one pass.
+ */
+class TarReader {
+public:
+    /**
+     * @brief Constructor
+     * @param device opened device, positioned at the first header
+     */
+    explicit TarReader(QIODevice * device);
+
+    /**
+     * @brief Advance to the next regular file
+     * @param entry receives the entry, offset is the position of its
+     * content in the uncompressed stream
+     * @return false on end of archive
+     * @throw KomiX::exception::ArchiveException on broken archive
+     *
+     * The unread content of the current entry is skipped.
+     */
+    bool next(Entry & entry);
+    /**
+     * @brief Read content of the current entry
+     * @return bytes read, 0 on end of the entry
+     * @throw KomiX::exception::ArchiveException on broken archive
+     */
+    qint64 read(char * data, qint64 maxSize);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
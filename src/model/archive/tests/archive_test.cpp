@@ -0,0 +1,123 @@
+/**
+ * @file archive_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+
+#include <QtCore/QFile>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+
+using KomiX::model::archive::getArchiveKey;
+using KomiX::model::archive::isTrailingVolume;
+using KomiX::model::archive::listVolumes;
+
+void touch(const QDir & dir, const QString & name, const QByteArray & content = QByteArray("volume")) {
+    QFile fout(dir.filePath(name));
+    fout.open(QIODevice::WriteOnly);
+    fout.write(content);
+}
+
+} // end of namespace
+
+class ArchiveTest : public QObject {
+    Q_OBJECT
+private slots:
+    void listsVolumes_data();
+    void listsVolumes();
+    void keysWholeSet();
+    void findsTrailingVolumes_data();
+    void findsTrailingVolumes();
+};
+
+void ArchiveTest::listsVolumes_data() {
+    QTest::addColumn<QStringList>("files");
+    QTest::addColumn<QString>("first");
+    QTest::addColumn<QStringList>("expected");
+
+    QStringList numbered;
+    numbered << "book.7z.001" << "book.7z.002" << "book.7z.003" << "book.7z.005";
+    QTest::newRow("numbered") << numbered << QString("book.7z.001") << (QStringList() << "book.7z.001" << "book.7z.002" << "book.7z.003");
+    QTest::newRow("not first") << numbered << QString("book.7z.002") << (QStringList() << "book.7z.002");
+
+    QStringList rar;
+    rar << "Book.part01.RAR" << "Book.part02.RAR" << "Book.part3.RAR";
+    QTest::newRow("rar") << rar << QString("Book.part01.RAR") << (QStringList() << "Book.part01.RAR" << "Book.part02.RAR");
+
+    QStringList plain;
+    plain << "book.zip" << "book.zip.bak";
+    QTest::newRow("plain") << plain << QString("book.zip") << (QStringList() << "book.zip");
+}
+
+void ArchiveTest::listsVolumes() {
+    QFETCH(QStringList, files);
+    QFETCH(QString, first);
+    QFETCH(QStringList, expected);
+
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    QDir dir(temp.path());
+    foreach (QString file, files) {
+        touch(dir, file);
+    }
+    QStringList paths;
+    foreach (QString file, expected) {
+        paths << dir.absoluteFilePath(file);
+    }
+    QCOMPARE(listVolumes(QFileInfo(dir.filePath(first))), paths);
+}
+
+void ArchiveTest::keysWholeSet() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    QDir dir(temp.path());
+    touch(dir, "book.7z.001");
+    touch(dir, "book.7z.002");
+    QFileInfo first(dir.filePath("book.7z.001"));
+
+    QString key = getArchiveKey(first);
+    QCOMPARE(getArchiveKey(first), key);
+    // only a trailing volume is replaced
+    touch(dir, "book.7z.002", "another volume");
+    QVERIFY(getArchiveKey(first) != key);
+}
+
+void ArchiveTest::findsTrailingVolumes_data() {
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<bool>("trailing");
+    QTest::newRow("7z first") << QString("book.7z.001") << false;
+    QTest::newRow("7z second") << QString("book.7z.002") << true;
+    QTest::newRow("cbz tenth") << QString("book.cbz.010") << true;
+    QTest::newRow("rar first") << QString("book.part1.rar") << false;
+    QTest::newRow("rar second") << QString("book.part02.rar") << true;
+    QTest::newRow("plain") << QString("book.rar") << false;
+    QTest::newRow("other extension") << QString("book.txt.002") << false;
+}
+
+void ArchiveTest::findsTrailingVolumes() {
+    QFETCH(QString, name);
+    QFETCH(bool, trailing);
+    QCOMPARE(isTrailingVolume(name), trailing);
+}
+
+QTEST_GUILESS_MAIN(ArchiveTest)
+
+#include "archive_test.moc"
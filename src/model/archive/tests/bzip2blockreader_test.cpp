@@ -0,0 +1,126 @@
+/**
+ * @file bzip2blockreader_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "bzip2blockreader.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtTest/QtTest>
+
+#include <bzlib.h>
+
+namespace {
+
+using KomiX::exception::ArchiveException;
+using KomiX::model::archive::Bzip2BlockReader;
+
+/// different on every block, bzip2 splits input every 100 kB at level 1
+QByteArray makeData(int size, quint32 seed) {
+    QByteArray data(size, '\0');
+    for (int i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        // a small alphabet, so the blocks are not stored as is
+        data[i] = 'a' + (seed >> 16) % 16;
+    }
+    return data;
+}
+
+QByteArray bzip2(const QByteArray & data, int level) {
+    unsigned int size = data.size() + data.size() / 100 + 600;
+    QByteArray packed(size, '\0');
+    BZ2_bzBuffToBuffCompress(packed.data(), &size, const_cast<char *>(data.constData()), data.size(), level, 0, 0);
+    packed.truncate(size);
+    return packed;
+}
+
+QByteArray readAll(QIODevice * device, int threads) {
+    Bzip2BlockReader reader(device, threads);
+    QByteArray data;
+    QByteArray chunk(10000, '\0');
+    qint64 n = 0;
+    while ((n = reader.read(chunk.data(), chunk.size())) > 0) {
+        data.append(chunk.constData(), n);
+    }
+    return data;
+}
+
+} // end of namespace
+
+class Bzip2BlockReaderTest : public QObject {
+    Q_OBJECT
+private slots:
+    void readsStreams_data();
+    void readsStreams();
+    void rejectsBrokenHeader();
+    void rejectsCorruptBlock();
+};
+
+void Bzip2BlockReaderTest::readsStreams_data() {
+    QTest::addColumn<QList<QByteArray>>("parts");
+    QTest::addColumn<int>("threads");
+    QList<QByteArray> single;
+    single << makeData(1000000, 1);
+    QList<QByteArray> concatenated;
+    concatenated << makeData(300000, 2) << makeData(5, 3) << makeData(450000, 4);
+    QTest::newRow("empty") << (QList<QByteArray>() << QByteArray()) << 2;
+    QTest::newRow("sequential") << single << 1;
+    QTest::newRow("parallel") << single << 4;
+    QTest::newRow("concatenated") << concatenated << 4;
+}
+
+void Bzip2BlockReaderTest::readsStreams() {
+    QFETCH(QList<QByteArray>, parts);
+    QFETCH(int, threads);
+
+    QByteArray data;
+    QByteArray packed;
+    int level = 1;
+    foreach (QByteArray part, parts) {
+        data += part;
+        // block sizes differ between streams
+        packed += bzip2(part, level);
+        level = level == 1 ? 9 : 1;
+    }
+    QBuffer buffer(&packed);
+    buffer.open(QIODevice::ReadOnly);
+    QCOMPARE(readAll(&buffer, threads), data);
+}
+
+void Bzip2BlockReaderTest::rejectsBrokenHeader() {
+    QByteArray packed = bzip2(makeData(1000, 5), 1);
+    packed[0] = 'X';
+    QBuffer buffer(&packed);
+    buffer.open(QIODevice::ReadOnly);
+    QVERIFY_EXCEPTION_THROWN(readAll(&buffer, 2), ArchiveException);
+}
+
+void Bzip2BlockReaderTest::rejectsCorruptBlock() {
+    QByteArray packed = bzip2(makeData(500000, 6), 1);
+    // somewhere inside the second block
+    int offset = packed.size() * 3 / 10;
+    packed[offset] = static_cast<char>(packed[offset] ^ 0x55);
+    QBuffer buffer(&packed);
+    buffer.open(QIODevice::ReadOnly);
+    QVERIFY_EXCEPTION_THROWN(readAll(&buffer, 4), ArchiveException);
+}
+
+QTEST_GUILESS_MAIN(Bzip2BlockReaderTest)
+
+#include "bzip2blockreader_test.moc"
@@ -0,0 +1,171 @@
+/**
+ * @file gzipindex_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "compresseddevice.hpp"
+#include "extractioncache.hpp"
+#include "gzipindex.hpp"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QtTest>
+
+#include <zlib.h>
+
+#include <cstring>
+
+namespace {
+
+using KomiX::exception::ArchiveException;
+using KomiX::model::archive::CompressedDevice;
+using KomiX::model::archive::ExtractionCache;
+using KomiX::model::archive::GzipIndex;
+
+const char * const KEY = "gzipindex-test";
+const qint64 MIB = 1024 * 1024;
+
+/// compressible but not trivially, so deflate emits many blocks
+QByteArray makeData(qint64 size, quint32 seed) {
+    static const char * const WORDS[] = {"komix ", "page ", "volume ", "chapter ", "\n", "panel ", "ink "};
+    QByteArray data;
+    data.reserve(size + 16);
+    while (data.size() < size) {
+        seed = seed * 1103515245 + 12345;
+        data.append(WORDS[(seed >> 16) % 7]);
+        data.append(QByteArray::number((seed >> 8) & 0xFF));
+    }
+    data.truncate(size);
+    return data;
+}
+
+QByteArray gzip(const QByteArray & data) {
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+    QByteArray packed(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef *>(packed.data());
+    zs.avail_out = packed.size();
+    deflate(&zs, Z_FINISH);
+    packed.truncate(zs.total_out);
+    deflateEnd(&zs);
+    return packed;
+}
+
+/// read @p path through a device which indexes into @p index
+QByteArray scan(const QString & path, std::shared_ptr<GzipIndex> index) {
+    std::shared_ptr<QFile> fin(new QFile(path));
+    if (!fin->open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    CompressedDevice device(fin, CompressedDevice::Gzip);
+    device.setIndex(index);
+    device.open(QIODevice::ReadOnly);
+    return device.readAll();
+}
+
+} // end of namespace
+
+class GzipIndexTest : public QObject {
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void readsAnywhere_data();
+    void readsAnywhere();
+    void rejectsUnindexedOffset();
+    void roundTrips();
+    void rejectsBogusCount();
+
+private:
+    QTemporaryDir temp_;
+    QString path_;
+    QByteArray data_;
+};
+
+void GzipIndexTest::initTestCase() {
+    // keep ExtractionCache away from the real cache
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(temp_.isValid());
+    QVERIFY(ExtractionCache::instance().isPrepared());
+
+    // two members, reads cross from one into the other
+    data_ = makeData(9 * MIB, 1) + makeData(6 * MIB, 2);
+    path_ = temp_.path() + "/book.tar.gz";
+    QFile fout(path_);
+    QVERIFY(fout.open(QIODevice::WriteOnly));
+    fout.write(gzip(data_.left(9 * MIB)) + gzip(data_.mid(9 * MIB)));
+}
+
+void GzipIndexTest::cleanupTestCase() {
+    QDir dir = ExtractionCache::instance().getDirectory(KEY);
+    dir.removeRecursively();
+}
+
+void GzipIndexTest::readsAnywhere_data() {
+    QTest::addColumn<qint64>("offset");
+    QTest::addColumn<qint64>("size");
+    QTest::newRow("head") << qint64(0) << qint64(4096);
+    QTest::newRow("across points") << 4 * MIB - 100 << qint64(300);
+    QTest::newRow("across members") << 9 * MIB - 1000 << qint64(5000);
+    QTest::newRow("tail") << 15 * MIB - 10 << qint64(10);
+}
+
+void GzipIndexTest::readsAnywhere() {
+    QFETCH(qint64, offset);
+    QFETCH(qint64, size);
+
+    std::shared_ptr<GzipIndex> index(new GzipIndex);
+    QCOMPARE(scan(path_, index), data_);
+    QCOMPARE(index->read(path_, offset, size), data_.mid(offset, size));
+}
+
+void GzipIndexTest::rejectsUnindexedOffset() {
+    GzipIndex index;
+    QVERIFY_EXCEPTION_THROWN(index.read(path_, 0, 1), ArchiveException);
+}
+
+void GzipIndexTest::roundTrips() {
+    std::shared_ptr<GzipIndex> index(new GzipIndex);
+    scan(path_, index);
+    index->save(KEY);
+
+    GzipIndex loaded;
+    QVERIFY(loaded.load(KEY));
+    QCOMPARE(loaded.read(path_, 12 * MIB, 1000), data_.mid(12 * MIB, 1000));
+}
+
+void GzipIndexTest::rejectsBogusCount() {
+    QFile fout(ExtractionCache::instance().getDirectory(KEY).filePath(".gzi"));
+    QVERIFY(fout.open(QIODevice::WriteOnly));
+    QDataStream out(&fout);
+    out << quint32(0x4b58475a) << quint32(1) << quint32(0xFFFFFFFF);
+    fout.close();
+
+    GzipIndex index;
+    QVERIFY(!index.load(KEY));
+}
+
+QTEST_GUILESS_MAIN(GzipIndexTest)
+
+#include "gzipindex_test.moc"
@@ -0,0 +1,99 @@
+/**
+ * @file journal_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "extractioncache.hpp"
+#include "journal.hpp"
+
+#include <QtCore/QFile>
+#include <QtCore/QStandardPaths>
+#include <QtTest/QtTest>
+
+namespace {
+
+using KomiX::model::archive::ExtractionCache;
+using KomiX::model::archive::appendJournal;
+using KomiX::model::archive::isExtractionComplete;
+using KomiX::model::archive::loadJournal;
+using KomiX::model::archive::markExtractionComplete;
+
+const char * const KEY = "journal-test";
+
+} // end of namespace
+
+class JournalTest : public QObject {
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanup();
+    void loadsNothingUnknown();
+    void appendsNames();
+    void ignoresTornLine();
+    void marksComplete();
+};
+
+void JournalTest::initTestCase() {
+    // keep ExtractionCache away from the real cache
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(ExtractionCache::instance().isPrepared());
+}
+
+void JournalTest::cleanup() {
+    QDir dir = ExtractionCache::instance().getDirectory(KEY);
+    dir.removeRecursively();
+}
+
+void JournalTest::loadsNothingUnknown() {
+    QVERIFY(loadJournal(KEY).isEmpty());
+    QVERIFY(!isExtractionComplete(KEY));
+}
+
+void JournalTest::appendsNames() {
+    appendJournal(KEY, QStringList() << "001.png" << QString::fromUtf8("\xc3\xa9t\xc3\xa9/002.png"));
+    appendJournal(KEY, QStringList());
+    appendJournal(KEY, QStringList() << "003.png");
+
+    QSet<QString> expected;
+    expected << "001.png" << QString::fromUtf8("\xc3\xa9t\xc3\xa9/002.png") << "003.png";
+    QCOMPARE(loadJournal(KEY), expected);
+}
+
+void JournalTest::ignoresTornLine() {
+    appendJournal(KEY, QStringList() << "001.png");
+    QFile fout(ExtractionCache::instance().getDirectory(KEY).filePath(".journal"));
+    QVERIFY(fout.open(QIODevice::WriteOnly | QIODevice::Append));
+    // killed in the middle of a line
+    fout.write("002.p");
+    fout.close();
+
+    QSet<QString> expected;
+    expected << "001.png";
+    QCOMPARE(loadJournal(KEY), expected);
+}
+
+void JournalTest::marksComplete() {
+    appendJournal(KEY, QStringList() << "001.png");
+    QVERIFY(!isExtractionComplete(KEY));
+    markExtractionComplete(KEY);
+    QVERIFY(isExtractionComplete(KEY));
+}
+
+QTEST_GUILESS_MAIN(JournalTest)
+
+#include "journal_test.moc"
@@ -0,0 +1,108 @@
+/**
+ * @file packindex_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "packindex.hpp"
+#include "ziparchive.hpp"
+
+#include <QtCore/QDataStream>
+#include <QtTest/QtTest>
+
+namespace {
+
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::ZipArchive;
+using KomiX::model::archive::loadPackIndex;
+using KomiX::model::archive::savePackIndex;
+
+std::vector<Entry> makeEntries() {
+    std::vector<Entry> entries;
+    for (int i = 0; i < 3; ++i) {
+        Entry entry;
+        entry.name = QString("vol1/%1.png").arg(i, 3, 10, QChar('0'));
+        entry.offset = 4096 + i * 100000;
+        entry.size = 99000 + i;
+        entry.crc32 = 0xCAFE0000 + i;
+        entry.width = 1200;
+        entry.height = 1800 + i;
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+/// a valid header followed by @p count and nothing else
+QByteArray makeHeader(quint32 count) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << quint32(0x4b58504b) << quint32(1) << count;
+    return data;
+}
+
+} // end of namespace
+
+class PackIndexTest : public QObject {
+    Q_OBJECT
+private slots:
+    void roundTrips();
+    void rejectsBrokenIndex_data();
+    void rejectsBrokenIndex();
+};
+
+void PackIndexTest::roundTrips() {
+    std::vector<Entry> saved = makeEntries();
+    std::vector<Entry> loaded;
+    QVERIFY(loadPackIndex(savePackIndex(saved), loaded));
+    QCOMPARE(loaded.size(), saved.size());
+    for (std::size_t i = 0; i < saved.size(); ++i) {
+        QCOMPARE(loaded[i].name, saved[i].name);
+        QCOMPARE(loaded[i].offset, saved[i].offset);
+        QCOMPARE(loaded[i].size, saved[i].size);
+        QCOMPARE(loaded[i].packedSize, saved[i].size);
+        QCOMPARE(loaded[i].crc32, saved[i].crc32);
+        QCOMPARE(loaded[i].width, saved[i].width);
+        QCOMPARE(loaded[i].height, saved[i].height);
+        QCOMPARE(loaded[i].method, int(ZipArchive::Stored));
+    }
+}
+
+void PackIndexTest::rejectsBrokenIndex_data() {
+    QTest::addColumn<QByteArray>("data");
+    QByteArray valid = savePackIndex(makeEntries());
+    QByteArray magic(valid);
+    magic[0] = 'X';
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("magic") << magic;
+    QTest::newRow("header") << valid.left(10);
+    QTest::newRow("record") << valid.left(valid.size() - 1);
+    QTest::newRow("count") << makeHeader(0xFFFFFFFF);
+    QTest::newRow("count in bounds") << makeHeader(1) + QByteArray(32, '\xFE');
+}
+
+void PackIndexTest::rejectsBrokenIndex() {
+    QFETCH(QByteArray, data);
+
+    // left untouched on failure
+    std::vector<Entry> entries = makeEntries();
+    QVERIFY(!loadPackIndex(data, entries));
+    QCOMPARE(entries.size(), makeEntries().size());
+}
+
+QTEST_GUILESS_MAIN(PackIndexTest)
+
+#include "packindex_test.moc"
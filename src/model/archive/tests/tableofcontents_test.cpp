@@ -0,0 +1,134 @@
+/**
+ * @file tableofcontents_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "extractioncache.hpp"
+#include "tableofcontents.hpp"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QStandardPaths>
+#include <QtTest/QtTest>
+
+namespace {
+
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::ExtractionCache;
+using KomiX::model::archive::loadTableOfContents;
+using KomiX::model::archive::saveTableOfContents;
+
+const char * const KEY = "tableofcontents-test";
+
+std::vector<Entry> makeEntries() {
+    std::vector<Entry> entries;
+    for (int i = 0; i < 3; ++i) {
+        Entry entry;
+        entry.name = QString("%1.png").arg(i);
+        entry.offset = i * 1000;
+        entry.packedSize = 900;
+        entry.size = 1000;
+        entry.method = 8;
+        entry.crc32 = 0xBEEF0000 + i;
+        entry.width = 800;
+        entry.height = 1200;
+        entry.container = "inner.zip";
+        entry.block = i / 2;
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+/// a valid header which claims @p count entries, and nothing else
+void writeHeader(quint32 count) {
+    QFile fout(ExtractionCache::instance().getDirectory(KEY).filePath(".toc"));
+    fout.open(QIODevice::WriteOnly);
+    QDataStream out(&fout);
+    out << quint32(0x4b585443) << quint32(3) << QString("zip") << count;
+}
+
+} // end of namespace
+
+class TableOfContentsTest : public QObject {
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanup();
+    void roundTrips();
+    void rejectsOtherBackend();
+    void rejectsBogusCount_data();
+    void rejectsBogusCount();
+};
+
+void TableOfContentsTest::initTestCase() {
+    // keep ExtractionCache away from the real cache
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(ExtractionCache::instance().isPrepared());
+}
+
+void TableOfContentsTest::cleanup() {
+    QDir dir = ExtractionCache::instance().getDirectory(KEY);
+    dir.removeRecursively();
+}
+
+void TableOfContentsTest::roundTrips() {
+    std::vector<Entry> saved = makeEntries();
+    saveTableOfContents(KEY, "zip", saved);
+
+    std::vector<Entry> loaded;
+    QVERIFY(loadTableOfContents(KEY, "zip", loaded));
+    QCOMPARE(loaded.size(), saved.size());
+    for (std::size_t i = 0; i < saved.size(); ++i) {
+        QCOMPARE(loaded[i].name, saved[i].name);
+        QCOMPARE(loaded[i].offset, saved[i].offset);
+        QCOMPARE(loaded[i].packedSize, saved[i].packedSize);
+        QCOMPARE(loaded[i].size, saved[i].size);
+        QCOMPARE(loaded[i].method, saved[i].method);
+        QCOMPARE(loaded[i].crc32, saved[i].crc32);
+        QCOMPARE(loaded[i].width, saved[i].width);
+        QCOMPARE(loaded[i].height, saved[i].height);
+        QCOMPARE(loaded[i].container, saved[i].container);
+        QCOMPARE(loaded[i].block, saved[i].block);
+    }
+}
+
+void TableOfContentsTest::rejectsOtherBackend() {
+    saveTableOfContents(KEY, "zip", makeEntries());
+    std::vector<Entry> loaded;
+    QVERIFY(!loadTableOfContents(KEY, "7z", loaded));
+}
+
+void TableOfContentsTest::rejectsBogusCount_data() {
+    QTest::addColumn<quint32>("count");
+    QTest::newRow("huge") << quint32(0xFFFFFFFF);
+    QTest::newRow("truncated") << quint32(1);
+}
+
+void TableOfContentsTest::rejectsBogusCount() {
+    QFETCH(quint32, count);
+    writeHeader(count);
+
+    // left untouched, the archive is listed again
+    std::vector<Entry> entries = makeEntries();
+    QVERIFY(!loadTableOfContents(KEY, "zip", entries));
+    QCOMPARE(entries.size(), makeEntries().size());
+}
+
+QTEST_GUILESS_MAIN(TableOfContentsTest)
+
+#include "tableofcontents_test.moc"
@@ -0,0 +1,251 @@
+/**
+ * @file tarreader_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "tarreader.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtTest/QtTest>
+
+#include <cstring>
+
+namespace {
+
+using KomiX::exception::ArchiveException;
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::TarReader;
+
+const int BLOCK_SIZE = 512;
+
+void put(QByteArray & block, int offset, const QByteArray & value) {
+    std::memcpy(block.data() + offset, value.constData(), value.size());
+}
+
+QByteArray octal(qint64 value, int width) {
+    return QByteArray::number(value, 8).rightJustified(width - 1, '0') + '\0';
+}
+
+/// writes the checksum of @p block
+QByteArray seal(QByteArray block) {
+    put(block, 148, "        ");
+    qint64 sum = 0;
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        sum += static_cast<unsigned char>(block[i]);
+    }
+    put(block, 148, QByteArray::number(sum, 8).rightJustified(6, '0') + '\0' + ' ');
+    return block;
+}
+
+/// a ustar header, the size is written in base-256 if @p binary is set
+QByteArray header(const QByteArray & name, qint64 size, char type, const QByteArray & prefix = QByteArray(), bool binary = false) {
+    QByteArray block(BLOCK_SIZE, '\0');
+    put(block, 0, name);
+    put(block, 100, octal(0644, 8));
+    put(block, 108, octal(0, 8));
+    put(block, 116, octal(0, 8));
+    if (binary) {
+        block[124] = static_cast<char>(0x80);
+        for (int i = 0; i < 8; ++i) {
+            block[135 - i] = static_cast<char>((size >> (i * 8)) & 0xFF);
+        }
+    } else {
+        put(block, 124, octal(size, 12));
+    }
+    put(block, 136, octal(0, 12));
+    block[156] = type;
+    put(block, 257, QByteArray("ustar", 6));
+    put(block, 263, "00");
+    put(block, 345, prefix);
+    return seal(block);
+}
+
+/// @p data padded to whole blocks
+QByteArray content(const QByteArray & data) {
+    QByteArray padded(data);
+    padded.append(QByteArray((BLOCK_SIZE - data.size() % BLOCK_SIZE) % BLOCK_SIZE, '\0'));
+    return padded;
+}
+
+QByteArray member(const QByteArray & name, const QByteArray & data) {
+    return header(name, data.size(), '0') + content(data);
+}
+
+QByteArray paxRecord(const QByteArray & key, const QByteArray & value) {
+    QByteArray body = " " + key + "=" + value + "\n";
+    // the length counts its own digits
+    int length = body.size() + 1;
+    while (QByteArray::number(length).size() + body.size() != length) {
+        ++length;
+    }
+    return QByteArray::number(length) + body;
+}
+
+QByteArray end() {
+    return QByteArray(BLOCK_SIZE * 2, '\0');
+}
+
+QByteArray readAll(TarReader & reader) {
+    QByteArray data;
+    char chunk[100];
+    qint64 n = 0;
+    while ((n = reader.read(chunk, sizeof(chunk))) > 0) {
+        data.append(chunk, n);
+    }
+    return data;
+}
+
+} // end of namespace
+
+class TarReaderTest : public QObject {
+    Q_OBJECT
+private slots:
+    void readsEntries();
+    void skipsUnreadContent();
+    void readsLongNames();
+    void readsBinarySize();
+    void rejectsBinarySize_data();
+    void rejectsBinarySize();
+    void stopsWithoutTrailer();
+    void rejectsBrokenHeader();
+};
+
+void TarReaderTest::readsEntries() {
+    QByteArray page(700, 'p');
+    QByteArray tar = header("book/", 0, '5') + member("book/001.png", page) + header("002.jpg", 3, '0', "book") + content("abc") + end();
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY(reader.next(entry));
+    QCOMPARE(entry.name, QString("book/001.png"));
+    QCOMPARE(entry.size, qint64(700));
+    // after the directory header and its own
+    QCOMPARE(entry.offset, qint64(BLOCK_SIZE * 2));
+    QCOMPARE(readAll(reader), page);
+
+    QVERIFY(reader.next(entry));
+    QCOMPARE(entry.name, QString("book/002.jpg"));
+    QCOMPARE(readAll(reader), QByteArray("abc"));
+
+    QVERIFY(!reader.next(entry));
+}
+
+void TarReaderTest::skipsUnreadContent() {
+    QByteArray tar = member("001.png", QByteArray(1500, 'a')) + member("002.png", "b") + end();
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY(reader.next(entry));
+    char chunk[10];
+    QCOMPARE(reader.read(chunk, sizeof(chunk)), qint64(10));
+    QVERIFY(reader.next(entry));
+    QCOMPARE(entry.name, QString("002.png"));
+    QCOMPARE(readAll(reader), QByteArray("b"));
+}
+
+void TarReaderTest::readsLongNames() {
+    QByteArray gnu(120, 'g');
+    gnu += ".png";
+    QByteArray pax(150, 'x');
+    pax += ".png";
+    QByteArray records = paxRecord("path", pax) + paxRecord("size", "4");
+    QByteArray tar = header("././@LongLink", gnu.size() + 1, 'L') + content(gnu + '\0') + member(gnu.left(100), "gnu!");
+    // the size field is ignored when pax gives one
+    tar += header("PaxHeaders/x", records.size(), 'x') + content(records) + header(pax.left(100), 0, '0') + content("pax!");
+    tar += end();
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY(reader.next(entry));
+    QCOMPARE(entry.name, QString::fromLatin1(gnu));
+    QCOMPARE(readAll(reader), QByteArray("gnu!"));
+    QVERIFY(reader.next(entry));
+    QCOMPARE(entry.name, QString::fromLatin1(pax));
+    QCOMPARE(entry.size, qint64(4));
+    QCOMPARE(readAll(reader), QByteArray("pax!"));
+    QVERIFY(!reader.next(entry));
+}
+
+void TarReaderTest::readsBinarySize() {
+    QByteArray tar = header("001.png", 5, '0', QByteArray(), true) + content("12345") + end();
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY(reader.next(entry));
+    QCOMPARE(entry.size, qint64(5));
+    QCOMPARE(readAll(reader), QByteArray("12345"));
+}
+
+void TarReaderTest::rejectsBinarySize_data() {
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<int>("byte");
+    // the size field is 124 to 135, only the last 8 bytes can be used
+    QTest::newRow("marker") << 124 << 0x81;
+    QTest::newRow("ninth byte") << 127 << 0x01;
+    QTest::newRow("sign bit") << 128 << 0x80;
+}
+
+void TarReaderTest::rejectsBinarySize() {
+    QFETCH(int, offset);
+    QFETCH(int, byte);
+    QByteArray block = header("001.png", 5, '0', QByteArray(), true);
+    block[offset] = static_cast<char>(byte);
+    QByteArray tar = seal(block) + content("12345") + end();
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY_EXCEPTION_THROWN(reader.next(entry), ArchiveException);
+}
+
+void TarReaderTest::stopsWithoutTrailer() {
+    QByteArray tar = member("001.png", "a");
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY(reader.next(entry));
+    QVERIFY(!reader.next(entry));
+}
+
+void TarReaderTest::rejectsBrokenHeader() {
+    QByteArray tar = member("001.png", "a") + end();
+    // not covered by the checksum any more
+    tar[0] = 'X';
+    QBuffer buffer(&tar);
+    buffer.open(QIODevice::ReadOnly);
+    TarReader reader(&buffer);
+
+    Entry entry;
+    QVERIFY_EXCEPTION_THROWN(reader.next(entry), ArchiveException);
+}
+
+QTEST_GUILESS_MAIN(TarReaderTest)
+
+#include "tarreader_test.moc"
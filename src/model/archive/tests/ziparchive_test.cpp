@@ -0,0 +1,229 @@
+/**
+ * @file ziparchive_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "ziparchive.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QtEndian>
+#include <QtTest/QtTest>
+
+#include <zlib.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+using KomiX::exception::ArchiveException;
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::ZipArchive;
+
+struct Member {
+    Member(const QByteArray & name, const QByteArray & data, int method)
+        : name(name)
+        , data(data)
+        , method(method) {
+    }
+
+    QByteArray name;
+    QByteArray data;
+    int method;
+};
+
+QByteArray le16(quint16 value) {
+    QByteArray bytes(2, '\0');
+    qToLittleEndian(value, reinterpret_cast<uchar *>(bytes.data()));
+    return bytes;
+}
+
+QByteArray le32(quint32 value) {
+    QByteArray bytes(4, '\0');
+    qToLittleEndian(value, reinterpret_cast<uchar *>(bytes.data()));
+    return bytes;
+}
+
+QByteArray le64(quint64 value) {
+    QByteArray bytes(8, '\0');
+    qToLittleEndian(value, reinterpret_cast<uchar *>(bytes.data()));
+    return bytes;
+}
+
+quint32 checksum(const QByteArray & data) {
+    return crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(data.constData()), data.size());
+}
+
+QByteArray deflateRaw(const QByteArray & data) {
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    QByteArray output(static_cast<int>(deflateBound(&zs, data.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef *>(output.data());
+    zs.avail_out = output.size();
+    deflate(&zs, Z_FINISH);
+    output.resize(static_cast<int>(zs.total_out));
+    deflateEnd(&zs);
+    return output;
+}
+
+/// a ZIP archive of @p members, with ZIP64 records if @p zip64 is set
+QByteArray makeZip(const std::vector<Member> & members, bool zip64, quint16 flags = 0) {
+    QByteArray zip;
+    QByteArray cd;
+    for (const Member & member : members) {
+        QByteArray packed = member.method == ZipArchive::Deflated ? deflateRaw(member.data) : member.data;
+        quint32 crc = checksum(member.data);
+        quint32 offset = zip.size();
+
+        zip += le32(0x04034b50) + le16(20) + le16(flags) + le16(member.method) + le16(0) + le16(0);
+        zip += le32(crc) + le32(packed.size()) + le32(member.data.size());
+        zip += le16(member.name.size()) + le16(0) + member.name + packed;
+
+        QByteArray extra;
+        if (zip64) {
+            // every field overflows, so all of them are in the extra field
+            extra = le16(0x0001) + le16(24) + le64(member.data.size()) + le64(packed.size()) + le64(offset);
+        }
+        cd += le32(0x02014b50) + le16(45) + le16(45) + le16(flags) + le16(member.method) + le16(0) + le16(0);
+        cd += le32(crc);
+        cd += zip64 ? (le32(0xFFFFFFFF) + le32(0xFFFFFFFF)) : (le32(packed.size()) + le32(member.data.size()));
+        cd += le16(member.name.size()) + le16(extra.size()) + le16(0) + le16(0) + le16(0) + le32(0);
+        cd += zip64 ? le32(0xFFFFFFFF) : le32(offset);
+        cd += member.name + extra;
+    }
+
+    quint32 cdOffset = zip.size();
+    zip += cd;
+    if (zip64) {
+        quint64 record = zip.size();
+        zip += le32(0x06064b50) + le64(44) + le16(45) + le16(45) + le32(0) + le32(0);
+        zip += le64(members.size()) + le64(members.size()) + le64(cd.size()) + le64(cdOffset);
+        zip += le32(0x07064b50) + le32(0) + le64(record) + le32(1);
+        zip += le32(0x06054b50) + le16(0xFFFF) + le16(0xFFFF) + le16(0xFFFF) + le16(0xFFFF);
+        zip += le32(0xFFFFFFFF) + le32(0xFFFFFFFF) + le16(0);
+    } else {
+        zip += le32(0x06054b50) + le16(0) + le16(0) + le16(members.size()) + le16(members.size());
+        zip += le32(cd.size()) + le32(cdOffset) + le16(0);
+    }
+    return zip;
+}
+
+std::shared_ptr<QIODevice> makeDevice(const QByteArray & data) {
+    QBuffer * buffer = new QBuffer;
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    return std::shared_ptr<QIODevice>(buffer);
+}
+
+std::vector<Member> makeMembers() {
+    std::vector<Member> members;
+    members.push_back(Member("001.png", QByteArray(1000, 'a'), ZipArchive::Stored));
+    QByteArray page;
+    for (int i = 0; i < 4096; ++i) {
+        page += QByteArray::number(i);
+    }
+    members.push_back(Member("chapter/002.jpg", page, ZipArchive::Deflated));
+    return members;
+}
+
+} // end of namespace
+
+class ZipArchiveTest : public QObject {
+    Q_OBJECT
+private slots:
+    void readsEntries_data();
+    void readsEntries();
+    void rejectsCorruptEntry();
+    void rejectsEncryptedArchive();
+    void rejectsTruncatedArchive();
+    void rejectsBogusDirectory_data();
+    void rejectsBogusDirectory();
+};
+
+void ZipArchiveTest::readsEntries_data() {
+    QTest::addColumn<bool>("zip64");
+    QTest::newRow("zip") << false;
+    QTest::newRow("zip64") << true;
+}
+
+void ZipArchiveTest::readsEntries() {
+    QFETCH(bool, zip64);
+    std::vector<Member> members = makeMembers();
+    ZipArchive archive(makeDevice(makeZip(members, zip64)));
+    archive.open();
+
+    const std::vector<Entry> & entries = archive.getEntries();
+    QCOMPARE(entries.size(), members.size());
+    for (size_t i = 0; i < members.size(); ++i) {
+        QCOMPARE(entries[i].name, QString::fromUtf8(members[i].name));
+        QCOMPARE(entries[i].method, members[i].method);
+        QCOMPARE(entries[i].size, static_cast<qint64>(members[i].data.size()));
+        QCOMPARE(archive.read(entries[i]), members[i].data);
+    }
+}
+
+void ZipArchiveTest::rejectsCorruptEntry() {
+    std::vector<Member> members = makeMembers();
+    QByteArray zip = makeZip(members, false);
+    // the first byte of the stored page
+    zip[30 + members[0].name.size()] = 'b';
+    ZipArchive archive(makeDevice(zip));
+    archive.open();
+    QVERIFY_EXCEPTION_THROWN(archive.read(archive.getEntries()[0]), ArchiveException);
+}
+
+void ZipArchiveTest::rejectsEncryptedArchive() {
+    ZipArchive archive(makeDevice(makeZip(makeMembers(), false, 0x0001)));
+    QVERIFY_EXCEPTION_THROWN(archive.open(), ArchiveException);
+}
+
+void ZipArchiveTest::rejectsTruncatedArchive() {
+    QByteArray zip = makeZip(makeMembers(), true);
+    // the end of central directory is gone
+    ZipArchive archive(makeDevice(zip.left(zip.size() - 10)));
+    QVERIFY_EXCEPTION_THROWN(archive.open(), ArchiveException);
+}
+
+void ZipArchiveTest::rejectsBogusDirectory_data() {
+    QTest::addColumn<int>("field");
+    QTest::addColumn<quint64>("value");
+    // fields of the ZIP64 end of central directory record
+    QTest::newRow("count") << 32 << Q_UINT64_C(0x0FFFFFFFFFFFFFFF);
+    QTest::newRow("size") << 40 << Q_UINT64_C(0x7FFFFFFFFFFFFFF0);
+    QTest::newRow("offset") << 48 << Q_UINT64_C(0x7FFFFFFFFFFFFFF0);
+    QTest::newRow("negative") << 48 << Q_UINT64_C(0xFFFFFFFFFFFFFFF0);
+}
+
+void ZipArchiveTest::rejectsBogusDirectory() {
+    QFETCH(int, field);
+    QFETCH(quint64, value);
+    QByteArray zip = makeZip(makeMembers(), true);
+    // the record is followed by the locator and the classic record
+    int record = zip.size() - 56 - 20 - 22;
+    zip.replace(record + field, 8, le64(value));
+    ZipArchive archive(makeDevice(zip));
+    QVERIFY_EXCEPTION_THROWN(archive.open(), ArchiveException);
+}
+
+QTEST_GUILESS_MAIN(ZipArchiveTest)
+
+#include "ziparchive_test.moc"
@@ -0,0 +1,165 @@
+/**
+ * @file volumedevice.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "volumedevice.hpp"
+
+#include <QtCore/QFile>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const qint64 READAHEAD_SIZE = 4 * 1024 * 1024;
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class VolumeDevice::Private {
+public:
+    explicit Private(const QStringList & paths);
+
+    int find(qint64 offset) const;
+    void advise(qint64 offset, qint64 length);
+
+    QStringList paths;
+    std::vector<std::shared_ptr<QFile>> volumes;
+    // logical offset of each volume, and the total size at last
+    std::vector<qint64> begins;
+    qint64 adviseBegin;
+    qint64 adviseEnd;
+};
+}
+}
+}
+
+using KomiX::model::archive::VolumeDevice;
+
+VolumeDevice::Private::Private(const QStringList & paths)
+    : paths(paths)
+    , volumes()
+    , begins()
+    , adviseBegin(0)
+    , adviseEnd(0) {
+}
+
+int VolumeDevice::Private::find(qint64 offset) const {
+    auto it = std::upper_bound(this->begins.begin(), this->begins.end(), offset);
+    return static_cast<int>(it - this->begins.begin()) - 1;
+}
+
+void VolumeDevice::Private::advise(qint64 offset, qint64 length) {
+    if (offset >= this->adviseBegin && offset + length <= this->adviseEnd) {
+        return;
+    }
+    this->adviseBegin = offset;
+    this->adviseEnd = std::min(offset + length + READAHEAD_SIZE, this->begins.back());
+#ifdef Q_OS_LINUX
+    // the system reads every volume in the window concurrently
+    for (int i = this->find(offset); i < static_cast<int>(this->volumes.size()) && this->begins[i] < this->adviseEnd; ++i) {
+        qint64 begin = std::max(this->adviseBegin, this->begins[i]) - this->begins[i];
+        qint64 end = std::min(this->adviseEnd, this->begins[i + 1]) - this->begins[i];
+        ::posix_fadvise(this->volumes[i]->handle(), begin, end - begin, POSIX_FADV_WILLNEED);
+    }
+#endif
+}
+
+VolumeDevice::VolumeDevice(const QStringList & paths)
+    : QIODevice()
+    , p_(new Private(paths)) {
+}
+
+bool VolumeDevice::open(OpenMode mode) {
+    if ((mode & QIODevice::WriteOnly) != 0) {
+        this->setErrorString("volumes are read only");
+        return false;
+    }
+    qint64 total = 0;
+    foreach (QString path, this->p_->paths) {
+        std::shared_ptr<QFile> volume(new QFile(path));
+        if (!volume->open(QIODevice::ReadOnly)) {
+            this->setErrorString(volume->errorString());
+            this->p_->volumes.clear();
+            this->p_->begins.clear();
+            return false;
+        }
+        this->p_->volumes.push_back(volume);
+        this->p_->begins.push_back(total);
+        total += volume->size();
+    }
+    this->p_->begins.push_back(total);
+    // reads go to the volumes at pos()
+    return this->QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void VolumeDevice::close() {
+    this->QIODevice::close();
+    this->p_->volumes.clear();
+    this->p_->begins.clear();
+    this->p_->adviseBegin = 0;
+    this->p_->adviseEnd = 0;
+}
+
+bool VolumeDevice::isSequential() const {
+    return false;
+}
+
+qint64 VolumeDevice::size() const {
+    return this->p_->begins.empty() ? 0 : this->p_->begins.back();
+}
+
+qint64 VolumeDevice::readData(char * data, qint64 maxSize) {
+    qint64 offset = this->pos();
+    maxSize = std::min(maxSize, this->size() - offset);
+    if (maxSize <= 0) {
+        return 0;
+    }
+    this->p_->advise(offset, maxSize);
+
+    qint64 done = 0;
+    while (done < maxSize) {
+        int i = this->p_->find(offset + done);
+        QFile * volume = this->p_->volumes[i].get();
+        qint64 local = offset + done - this->p_->begins[i];
+        qint64 length = std::min(maxSize - done, this->p_->begins[i + 1] - this->p_->begins[i] - local);
+        if (!volume->seek(local)) {
+            this->setErrorString(volume->errorString());
+            return done > 0 ? done : -1;
+        }
+        qint64 n = volume->read(data + done, length);
+        if (n <= 0) {
+            this->setErrorString(volume->errorString());
+            return done > 0 ? done : -1;
+        }
+        done += n;
+    }
+    return done;
+}
+
+qint64 VolumeDevice::writeData(const char * /*data*/, qint64 /*maxSize*/) {
+    return -1;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file volumedevice.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_VOLUMEDEVICE_HPP
+#define KOMIX_MODEL_ARCHIVE_VOLUMEDEVICE_HPP
+
+#include <QtCore/QIODevice>
+#include <QtCore/QStringList>
+
+#include <memory>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief Read-only random access device over the volumes of a split archive
+ *
+ * The volumes are read as one file, so entries spanning two of them are
+ * read in place. Each read asks the system to fetch a window ahead of it,
+ * from every volume the window covers at once.
+ */
+class VolumeDevice : public QIODevice {
+public:
+    /**
+     * @brief Constructor
+     * @param paths volume files in order
+     */
+    explicit VolumeDevice(const QStringList & paths);
+
+    /// Overrides from QIODevice, only QIODevice::ReadOnly is supported
+    virtual bool open(OpenMode mode);
+    /// Overrides from QIODevice
+    virtual void close();
+    /// Overrides from QIODevice
+    virtual bool isSequential() const;
+    /// Overrides from QIODevice, total size of all volumes
+    virtual qint64 size() const;
+
+protected:
+    virtual qint64 readData(char * data, qint64 maxSize);
+    virtual qint64 writeData(const char * data, qint64 maxSize);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
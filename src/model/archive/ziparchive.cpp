@@ -0,0 +1,334 @@
+/**
+ * @file ziparchive.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "packindex.hpp"
+#include "ziparchive.hpp"
+
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QtEndian>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const quint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const quint32 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+const quint32 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+const quint32 ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+const quint32 ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+const qint64 LOCAL_HEADER_SIZE = 30;
+const qint64 CENTRAL_HEADER_SIZE = 46;
+const qint64 END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+const qint64 MAX_COMMENT_SIZE = 0xFFFF;
+const qint64 ZIP64_LOCATOR_SIZE = 20;
+const qint64 ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+const quint16 ZIP64_EXTRA_ID = 0x0001;
+const quint32 ZIP64_MAGIC = 0xFFFFFFFF;
+const quint16 FLAG_ENCRYPTED = 0x0001;
+const quint16 FLAG_UTF8 = 0x0800;
+
+inline quint16 u16(const char * p) {
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(p));
+}
+
+inline quint32 u32(const char * p) {
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(p));
+}
+
+inline quint64 u64(const char * p) {
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(p));
+}
+
+QByteArray inflateRaw(const QByteArray & input, qint64 size) {
+    QByteArray output;
+    if (size == 0) {
+        return output;
+    }
+    output.resize(size);
+
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+        throw KomiX::exception::ArchiveException("can not initialize zlib");
+    }
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.constData()));
+    zs.avail_in = input.size();
+    zs.next_out = reinterpret_cast<Bytef *>(output.data());
+    zs.avail_out = output.size();
+    int ret = inflate(&zs, Z_FINISH);
+    qint64 total = zs.total_out;
+    inflateEnd(&zs);
+    if (ret != Z_STREAM_END || total != size) {
+        throw KomiX::exception::ArchiveException("broken deflate stream");
+    }
+    return output;
+}
+
+quint32 checksum(const QByteArray & data) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    return crc32(crc, reinterpret_cast<const Bytef *>(data.constData()), data.size());
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+class ZipArchive::Private {
+public:
+    explicit Private(std::shared_ptr<QIODevice> device);
+
+    QByteArray readAt(qint64 offset, qint64 length);
+    qint64 getDataOffset(const Entry & entry);
+    void findCentralDirectory(qint64 & offset, qint64 & size, qint64 & count);
+    void parseCentralDirectory(const QByteArray & cd, qint64 count);
+
+    std::shared_ptr<QIODevice> device;
+    QMutex lock;
+    std::vector<Entry> entries;
+};
+}
+}
+}
+
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::ZipArchive;
+using KomiX::exception::ArchiveException;
+
+ZipArchive::Private::Private(std::shared_ptr<QIODevice> device)
+    : device(device)
+    , lock()
+    , entries() {
+}
+
+QByteArray ZipArchive::Private::readAt(qint64 offset, qint64 length) {
+    // sizes come from the archive, never allocate past its end
+    qint64 fileSize = this->device->size();
+    if (offset < 0 || length < 0 || offset > fileSize || length > fileSize - offset) {
+        throw ArchiveException("unexpected end of archive");
+    }
+    if (!this->device->seek(offset)) {
+        throw ArchiveException("can not seek in archive");
+    }
+    QByteArray chunk = this->device->read(length);
+    if (chunk.size() != length) {
+        throw ArchiveException("unexpected end of archive");
+    }
+    return chunk;
+}
+
+qint64 ZipArchive::Private::getDataOffset(const Entry & entry) {
+    QByteArray header = this->readAt(entry.offset, LOCAL_HEADER_SIZE);
+    if (u32(header.constData()) != LOCAL_HEADER_SIGNATURE) {
+        throw ArchiveException("broken local header");
+    }
+    // name and extra field may differ from the central directory
+    return entry.offset + LOCAL_HEADER_SIZE + u16(header.constData() + 26) + u16(header.constData() + 28);
+}
+
+void ZipArchive::Private::findCentralDirectory(qint64 & offset, qint64 & size, qint64 & count) {
+    qint64 fileSize = this->device->size();
+    if (fileSize < END_OF_CENTRAL_DIRECTORY_SIZE) {
+        throw ArchiveException("not a ZIP archive");
+    }
+    // the record is at the end, followed by a comment of at most 64 KiB
+    qint64 tailSize = std::min(fileSize, END_OF_CENTRAL_DIRECTORY_SIZE + MAX_COMMENT_SIZE);
+    qint64 tailOffset = fileSize - tailSize;
+    QByteArray tail = this->readAt(tailOffset, tailSize);
+    int pos = tail.size() - END_OF_CENTRAL_DIRECTORY_SIZE;
+    while (pos >= 0 && u32(tail.constData() + pos) != END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+        --pos;
+    }
+    if (pos < 0) {
+        throw ArchiveException("not a ZIP archive");
+    }
+    const char * eocd = tail.constData() + pos;
+    count = u16(eocd + 10);
+    size = u32(eocd + 12);
+    offset = u32(eocd + 16);
+
+    qint64 eocdOffset = tailOffset + pos;
+    if (eocdOffset >= ZIP64_LOCATOR_SIZE) {
+        QByteArray locator = this->readAt(eocdOffset - ZIP64_LOCATOR_SIZE, ZIP64_LOCATOR_SIZE);
+        if (u32(locator.constData()) == ZIP64_LOCATOR_SIGNATURE) {
+            QByteArray record = this->readAt(u64(locator.constData() + 8), ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE);
+            if (u32(record.constData()) != ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+                throw ArchiveException("broken ZIP64 end of central directory");
+            }
+            count = u64(record.constData() + 32);
+            size = u64(record.constData() + 40);
+            offset = u64(record.constData() + 48);
+        }
+    }
+
+    // ZIP64 fields are 64 bits wide, large ones turn negative here
+    if (offset < 0 || size < 0 || count < 0 || offset > fileSize || size > fileSize - offset) {
+        throw ArchiveException("broken central directory");
+    }
+    // the count is not trusted, a broken archive must not allocate for it
+    if (count > size / CENTRAL_HEADER_SIZE) {
+        throw ArchiveException("broken central directory");
+    }
+}
+
+void ZipArchive::Private::parseCentralDirectory(const QByteArray & cd, qint64 count) {
+    const char * p = cd.constData();
+    const char * end = p + cd.size();
+    this->entries.clear();
+    this->entries.reserve(count);
+    for (qint64 i = 0; i < count; ++i) {
+        if (end - p < CENTRAL_HEADER_SIZE || u32(p) != CENTRAL_HEADER_SIGNATURE) {
+            throw ArchiveException("broken central directory");
+        }
+        quint16 flags = u16(p + 8);
+        if (flags & FLAG_ENCRYPTED) {
+            throw ArchiveException("encrypted ZIP archive is not supported");
+        }
+        quint16 nameLength = u16(p + 28);
+        quint16 extraLength = u16(p + 30);
+        quint16 commentLength = u16(p + 32);
+        const char * name = p + CENTRAL_HEADER_SIZE;
+        const char * extra = name + nameLength;
+        const char * extraEnd = extra + extraLength;
+        const char * next = extraEnd + commentLength;
+        if (next > end) {
+            throw ArchiveException("broken central directory");
+        }
+
+        Entry entry;
+        QByteArray rawName(name, nameLength);
+        entry.name = (flags & FLAG_UTF8) ? QString::fromUtf8(rawName) : QString::fromLocal8Bit(rawName);
+        entry.name.replace('\\', '/');
+        entry.method = u16(p + 10);
+        entry.crc32 = u32(p + 16);
+        entry.packedSize = u32(p + 20);
+        entry.size = u32(p + 24);
+        entry.offset = u32(p + 42);
+
+        // ZIP64 extended information only holds the overflowed fields
+        const char * x = extra;
+        while (extraEnd - x >= 4) {
+            quint16 id = u16(x);
+            const char * field = x + 4;
+            const char * fieldEnd = field + u16(x + 2);
+            if (fieldEnd > extraEnd) {
+                break;
+            }
+            if (id == ZIP64_EXTRA_ID) {
+                if (entry.size == ZIP64_MAGIC && fieldEnd - field >= 8) {
+                    entry.size = u64(field);
+                    field += 8;
+                }
+                if (entry.packedSize == ZIP64_MAGIC && fieldEnd - field >= 8) {
+                    entry.packedSize = u64(field);
+                    field += 8;
+                }
+                if (entry.offset == ZIP64_MAGIC && fieldEnd - field >= 8) {
+                    entry.offset = u64(field);
+                    field += 8;
+                }
+            }
+            x = fieldEnd;
+        }
+
+        this->entries.push_back(entry);
+        p = next;
+    }
+}
+
+ZipArchive::ZipArchive(std::shared_ptr<QIODevice> device)
+    : p_(new Private(device)) {
+}
+
+void ZipArchive::open() {
+    QMutexLocker locker(&this->p_->lock);
+    Q_UNUSED(locker);
+    qint64 offset = 0, size = 0, count = 0;
+    this->p_->findCentralDirectory(offset, size, count);
+    this->p_->parseCentralDirectory(this->p_->readAt(offset, size), count);
+}
+
+bool ZipArchive::openIndex() {
+    QMutexLocker locker(&this->p_->lock);
+    Q_UNUSED(locker);
+    try {
+        if (this->p_->device->size() < LOCAL_HEADER_SIZE) {
+            return false;
+        }
+        QByteArray header = this->p_->readAt(0, LOCAL_HEADER_SIZE);
+        if (u32(header.constData()) != LOCAL_HEADER_SIGNATURE || u16(header.constData() + 8) != Stored) {
+            return false;
+        }
+        quint16 nameLength = u16(header.constData() + 26);
+        quint16 extraLength = u16(header.constData() + 28);
+        if (this->p_->readAt(LOCAL_HEADER_SIZE, nameLength) != PACK_INDEX_NAME) {
+            return false;
+        }
+        QByteArray data = this->p_->readAt(LOCAL_HEADER_SIZE + nameLength + extraLength, u32(header.constData() + 22));
+        if (checksum(data) != u32(header.constData() + 14)) {
+            return false;
+        }
+        return loadPackIndex(data, this->p_->entries);
+    } catch (ArchiveException &) {
+        return false;
+    }
+}
+
+const std::vector<Entry> & ZipArchive::getEntries() const {
+    return this->p_->entries;
+}
+
+qint64 ZipArchive::getDataOffset(const Entry & entry) const {
+    QMutexLocker locker(&this->p_->lock);
+    Q_UNUSED(locker);
+    return this->p_->getDataOffset(entry);
+}
+
+QByteArray ZipArchive::read(const Entry & entry) const {
+    QByteArray raw;
+    {
+        // only the device access needs to be serialized
+        QMutexLocker locker(&this->p_->lock);
+        Q_UNUSED(locker);
+        raw = this->p_->readAt(this->p_->getDataOffset(entry), entry.packedSize);
+    }
+
+    QByteArray data;
+    switch (entry.method) {
+        case Stored:
+            data = raw;
+            break;
+        case Deflated:
+            data = inflateRaw(raw, entry.size);
+            break;
+        default:
+            throw ArchiveException(QString("unsupported compression method %1").arg(entry.method));
+    }
+    if (data.size() != entry.size || checksum(data) != entry.crc32) {
+        throw ArchiveException(QString("CRC error: %1").arg(entry.name));
+    }
+    return data;
+}
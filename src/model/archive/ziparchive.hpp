@@ -0,0 +1,94 @@
+/**
+ * @file ziparchive.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_ZIPARCHIVE_HPP
+#define KOMIX_MODEL_ARCHIVE_ZIPARCHIVE_HPP
+
+#include "entry.hpp"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QIODevice>
+
+#include <memory>
+#include <vector>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief In-process ZIP reader
+ *
+ * Reads the central directory once, then reads each entry on demand.
+ * Supports stored and deflated entries, and ZIP64 archives.
+ * Do not support encryption.
+ */
+class ZipArchive {
+public:
+    /// Method value of stored entries
+    static const int Stored = 0;
+    /// Method value of deflated entries
+    static const int Deflated = 8;
+
+    /**
+     * @brief Constructor with a random access device
+     * @param device opened device
+     */
+    explicit ZipArchive(std::shared_ptr<QIODevice> device);
+
+    /**
+     * @brief Parse the central directory
+     * @throw KomiX::exception::ArchiveException if not a readable ZIP
+     */
+    void open();
+    /**
+     * @brief Read the index written by komix-repack instead
+     * @return false if the archive does not begin with one
+     *
+     * Only the first local header is read, the central directory is not
+     * needed. Entries are the pages in reading order.
+     */
+    bool openIndex();
+
+    /// Get all entries in central directory order
+    const std::vector<Entry> & getEntries() const;
+
+    /**
+     * @brief Get offset of entry data in the archive
+     * @throw KomiX::exception::ArchiveException on broken local header
+     */
+    qint64 getDataOffset(const Entry & entry) const;
+    /**
+     * @brief Read and decompress the whole entry
+     * @throw KomiX::exception::ArchiveException on broken or unsupported entry
+     *
+     * This function is thread-safe.
+     */
+    QByteArray read(const Entry & entry) const;
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,642 @@
+/**
+ * @file zipmodel.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "deferredfile.hpp"
+#include "extractioncache.hpp"
+#include "extractionscheduler.hpp"
+#include "global.hpp"
+#include "mappeddevice.hpp"
+#include "tableofcontents.hpp"
+#include "volumedevice.hpp"
+#include "zipmodel_p.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QFile>
+#include <QtCore/QThreadPool>
+#include <QtCore/QtDebug>
+#include <QtGui/QImageReader>
+
+#include <algorithm>
+
+namespace {
+
+/// inner archives kept open, inflated ones are held in memory
+const int NESTED_CACHE_SIZE = 2;
+/// count of entries inflated ahead of the requested one
+const int PREFETCH_SIZE = 4;
+/// bytes of inflated entries not requested yet
+const qint64 PREFETCH_BUDGET = 64 * 1024 * 1024;
+
+/// threads inflating ahead, apart from the global pool used by loaders
+QThreadPool & prefetchPool() {
+    static QThreadPool pool;
+    return pool;
+}
+
+/// same order as QDir::Name | QDir::IgnoreCase
+bool entryLessThan(const KomiX::model::archive::Entry & l, const KomiX::model::archive::Entry & r) {
+    return QString::compare(l.name, r.name, Qt::CaseInsensitive) < 0;
+}
+
+/// the page of an inner archive which is stored in a stored one is a plain file region
+QIODevice * mapNested(const QString & path, const KomiX::model::archive::ZipChapters::Nested & inner,
+                      const KomiX::model::archive::Entry & entry) {
+    if (entry.method != KomiX::model::archive::ZipArchive::Stored || inner.base < 0) {
+        return nullptr;
+    }
+    KomiX::MappedDevice * mapped = new KomiX::MappedDevice(path, inner.base + inner.archive->getDataOffset(entry), entry.size);
+    if (mapped->isMapped()) {
+        return mapped;
+    }
+    delete mapped;
+    return nullptr;
+}
+
+} // end of namespace
+
+namespace {
+
+class Inflater : public QRunnable {
+public:
+    Inflater(std::shared_ptr<KomiX::model::archive::ZipArchive> archive, const KomiX::model::archive::Entry & entry,
+             std::shared_ptr<KomiX::model::archive::InflatedEntry> result)
+        : QRunnable()
+        , archive(archive)
+        , entry(entry)
+        , result(result) {
+    }
+
+    virtual void run() {
+        if (!this->result->claim()) {
+            // read directly by the model
+            return;
+        }
+        QByteArray data;
+        try {
+            data = this->archive->read(this->entry);
+        } catch (KomiX::exception::ArchiveException & e) {
+            qWarning() << e.getMessage();
+        }
+        this->result->set(data);
+    }
+
+private:
+    // keeps the archive readable even if the model is gone
+    std::shared_ptr<KomiX::model::archive::ZipArchive> archive;
+    KomiX::model::archive::Entry entry;
+    std::shared_ptr<KomiX::model::archive::InflatedEntry> result;
+};
+
+} // end of namespace
+
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::InflatedEntry;
+using KomiX::model::archive::ZipArchive;
+using KomiX::model::archive::ZipChapterLister;
+using KomiX::model::archive::ZipChapterReader;
+using KomiX::model::archive::ZipChapters;
+using KomiX::model::archive::ZipModel;
+using KomiX::exception::ArchiveException;
+
+InflatedEntry::InflatedEntry()
+    : QObject()
+    , lock()
+    , state(Waiting)
+    , data() {
+}
+
+bool InflatedEntry::claim() {
+    QMutexLocker locker(&this->lock);
+    if (this->state != Waiting) {
+        return false;
+    }
+    this->state = Running;
+    return true;
+}
+
+bool InflatedEntry::cancel() {
+    QMutexLocker locker(&this->lock);
+    if (this->state != Waiting) {
+        return false;
+    }
+    this->state = Canceled;
+    return true;
+}
+
+void InflatedEntry::set(const QByteArray & data) {
+    QMutexLocker locker(&this->lock);
+    this->state = Finished;
+    this->data = data;
+    // under the lock, so take() never misses it
+    emit this->finished(data);
+}
+
+QIODevice * InflatedEntry::take() {
+    QMutexLocker locker(&this->lock);
+    if (this->state == Finished) {
+        QBuffer * buffer = new QBuffer;
+        buffer->setData(this->data);
+        buffer->open(QIODevice::ReadOnly);
+        this->data = QByteArray();
+        return buffer;
+    }
+    // the worker is on it, do not wait
+    DeferredFile * device = new DeferredFile(QString());
+    device->connect(this, SIGNAL(finished(const QByteArray &)), SLOT(complete(const QByteArray &)));
+    return device;
+}
+
+ZipChapters::ZipChapters(const QString & path, std::shared_ptr<ZipArchive> archive, bool opened, bool split)
+    : path(path)
+    , archive(archive)
+    , opened(opened)
+    , split(split)
+    , lock()
+    , nested() {
+}
+
+bool ZipChapters::find(const QString & name, Nested & inner) {
+    QMutexLocker locker(&this->lock);
+    auto it = this->nested.find(name);
+    if (it == this->nested.end()) {
+        return false;
+    }
+    inner = it.value();
+    return true;
+}
+
+ZipChapters::Nested ZipChapters::open(const QString & name, bool keep) {
+    Nested inner;
+    if (this->find(name, inner)) {
+        return inner;
+    }
+    Entry container;
+    {
+        QMutexLocker locker(&this->lock);
+        if (!this->opened) {
+            // table of contents was cached, but the outer entry is needed now
+            this->archive->open();
+            this->opened = true;
+        }
+        const std::vector<Entry> & outer = this->archive->getEntries();
+        auto it = std::find_if(outer.begin(), outer.end(), [&name](const Entry & entry) -> bool { return entry.name == name; });
+        if (it == outer.end()) {
+            throw ArchiveException(QString("missing inner archive %1").arg(name));
+        }
+        container = *it;
+    }
+
+    std::shared_ptr<QIODevice> device;
+    if (container.method == ZipArchive::Stored && !this->split) {
+        // a stored inner archive is read in place
+        inner.base = this->archive->getDataOffset(container);
+        MappedDevice * mapped = new MappedDevice(this->path, inner.base, container.size);
+        device.reset(mapped);
+        if (!mapped->isMapped()) {
+            device.reset();
+            inner.base = -1;
+        }
+    }
+    if (!device) {
+        // not under the lock, pages of open chapters stay readable
+        QBuffer * buffer = new QBuffer;
+        buffer->setData(this->archive->read(container));
+        buffer->open(QIODevice::ReadOnly);
+        device.reset(buffer);
+    }
+    inner.archive.reset(new ZipArchive(device));
+    inner.archive->open();
+
+    if (keep) {
+        QMutexLocker locker(&this->lock);
+        if (this->nested.size() >= NESTED_CACHE_SIZE) {
+            this->nested.clear();
+        }
+        this->nested.insert(name, inner);
+    }
+    return inner;
+}
+
+ZipChapterLister::ZipChapterLister(std::shared_ptr<ZipChapters> chapters, const QStringList & names, std::shared_ptr<ZipChapterPages> result)
+    : QObject()
+    , QRunnable()
+    , chapters(chapters)
+    , names(names)
+    , result(result) {
+}
+
+void ZipChapterLister::run() {
+    foreach (QString name, this->names) {
+        std::vector<Entry> pages;
+        try {
+            // only the directory is needed, the chapter is inflated again for its pages
+            ZipChapters::Nested inner = this->chapters->open(name, false);
+            for (Entry entry : inner.archive->getEntries()) {
+                if (entry.name.endsWith('/') || !SupportedFormats().contains(QFileInfo(entry.name).suffix().toLower())) {
+                    continue;
+                }
+                if (entry.method != ZipArchive::Stored && entry.method != ZipArchive::Deflated) {
+                    throw ArchiveException(QString("unsupported compression method %1").arg(entry.method));
+                }
+                // sorts as one chapter
+                entry.name = name + "/" + entry.name;
+                entry.container = name;
+                pages.push_back(entry);
+            }
+        } catch (ArchiveException & e) {
+            // a broken chapter does not hide the others
+            emit this->failed(QString("%1: %2").arg(name).arg(e.getMessage()));
+            continue;
+        }
+        {
+            QMutexLocker locker(&this->result->lock);
+            this->result->pages.insert(this->result->pages.end(), pages.begin(), pages.end());
+        }
+        emit this->listed();
+    }
+    emit this->finished();
+}
+
+ZipChapterReader::ZipChapterReader(std::shared_ptr<ZipChapters> chapters, const Entry & entry)
+    : QObject()
+    , QRunnable()
+    , chapters(chapters)
+    , entry(entry) {
+}
+
+void ZipChapterReader::run() {
+    QByteArray data;
+    try {
+        data = this->chapters->open(this->entry.container, true).archive->read(this->entry);
+    } catch (ArchiveException & e) {
+        qWarning() << e.getMessage();
+    }
+    emit this->finished(data);
+}
+
+ZipModel::Private::Private(ZipModel * owner, const QFileInfo & root)
+    : QObject()
+    , owner(owner)
+    , root(root)
+    , key(getArchiveKey(root))
+    , archive()
+    , split(false)
+    , entries()
+    , unlisted()
+    , chapters()
+    , listing(new ZipChapterPages)
+    , published(false)
+    , broken(false)
+    , dirty(false)
+    , prefetched()
+    , prefetchedSize(0) {
+    QStringList volumes = listVolumes(root);
+    this->split = volumes.size() > 1;
+    std::shared_ptr<QIODevice> fin;
+    if (this->split) {
+        fin.reset(new VolumeDevice(volumes));
+    } else {
+        fin.reset(new QFile(root.absoluteFilePath()));
+    }
+    if (!fin->open(QIODevice::ReadOnly)) {
+        throw ArchiveException(QString("can not open %1").arg(root.absoluteFilePath()));
+    }
+    this->archive.reset(new ZipArchive(fin));
+
+    bool opened = false;
+    // entries carry their own offsets, the central directory is not needed
+    if (!loadTableOfContents(this->key, "zip", this->entries)) {
+        if (this->archive->openIndex()) {
+            // repacked, pages are listed up front in reading order
+            this->entries = this->archive->getEntries();
+        } else {
+            this->archive->open();
+            opened = true;
+
+            for (const Entry & entry : this->archive->getEntries()) {
+                if (!entry.name.endsWith('/') && ZipModel::IsSupported(entry.name.toLower())) {
+                    // chapters packed as inner archives are listed later
+                    this->unlisted << entry.name;
+                } else if (this->isPage(entry)) {
+                    this->entries.push_back(entry);
+                }
+            }
+            std::sort(this->entries.begin(), this->entries.end(), entryLessThan);
+        }
+        if (this->unlisted.isEmpty()) {
+            saveTableOfContents(this->key, "zip", this->entries);
+        }
+    }
+    this->chapters.reset(new ZipChapters(root.absoluteFilePath(), this->archive, opened, this->split));
+    ExtractionCache::instance().acquire(this->key);
+}
+
+ZipModel::Private::~Private() {
+    ExtractionScheduler::instance().cancel(this);
+    if (this->dirty && this->unlisted.isEmpty()) {
+        // remember image sizes found during this session
+        saveTableOfContents(this->key, "zip", this->entries);
+    }
+    ExtractionCache::instance().release(this->key);
+}
+
+bool ZipModel::Private::isPage(const Entry & entry) const {
+    if (entry.name.endsWith('/') || !SupportedFormats().contains(QFileInfo(entry.name).suffix().toLower())) {
+        return false;
+    }
+    if (entry.method != ZipArchive::Stored && entry.method != ZipArchive::Deflated) {
+        throw ArchiveException(QString("unsupported compression method %1").arg(entry.method));
+    }
+    return true;
+}
+
+void ZipModel::Private::listChapters() {
+    // inner directories may need the whole chapter inflated
+    ZipChapterLister * lister = new ZipChapterLister(this->chapters, this->unlisted, this->listing);
+    this->connect(lister, SIGNAL(listed()), SLOT(onChapterListed()));
+    this->connect(lister, SIGNAL(failed(const QString &)), SLOT(onChapterFailed(const QString &)));
+    this->connect(lister, SIGNAL(finished()), SLOT(onChaptersFinished()));
+    ExtractionScheduler::instance().start(lister, ExtractionScheduler::Foreground, this);
+}
+
+void ZipModel::Private::insertEntries(std::vector<Entry> & incoming) {
+    if (incoming.empty()) {
+        return;
+    }
+    std::sort(incoming.begin(), incoming.end(), entryLessThan);
+    // rows move, prefetched ones are keyed by row
+    foreach (Prefetched ahead, this->prefetched) {
+        ahead.result->cancel();
+    }
+    this->prefetched.clear();
+    this->prefetchedSize = 0;
+    int size = static_cast<int>(this->entries.size());
+    if (this->entries.empty() || entryLessThan(this->entries.back(), incoming.front())) {
+        // common case, append as one batch
+        this->owner->beginInsertRows(QModelIndex(), size, size + static_cast<int>(incoming.size()) - 1);
+        this->entries.insert(this->entries.end(), incoming.begin(), incoming.end());
+        this->owner->endInsertRows();
+    } else {
+        for (const Entry & entry : incoming) {
+            auto it = std::lower_bound(this->entries.begin(), this->entries.end(), entry, entryLessThan);
+            int row = static_cast<int>(it - this->entries.begin());
+            this->owner->beginInsertRows(QModelIndex(), row, row);
+            this->entries.insert(it, entry);
+            this->owner->endInsertRows();
+        }
+    }
+    if (!this->published) {
+        // the first page is readable
+        this->published = true;
+        emit this->ready();
+    }
+}
+
+void ZipModel::Private::onChapterListed() {
+    std::vector<Entry> pages;
+    {
+        QMutexLocker locker(&this->listing->lock);
+        pages.swap(this->listing->pages);
+    }
+    this->insertEntries(pages);
+}
+
+void ZipModel::Private::onChapterFailed(const QString & message) {
+    // listed again next time, so the error is not forgotten
+    this->broken = true;
+    qWarning() << message;
+    emit this->error(message);
+}
+
+void ZipModel::Private::onChaptersFinished() {
+    if (!this->broken) {
+        this->unlisted.clear();
+        // chapters are listed from the cache next time
+        saveTableOfContents(this->key, "zip", this->entries);
+    }
+    if (!this->published) {
+        // nothing readable, still tell the controller
+        this->published = true;
+        emit this->ready();
+    }
+    emit this->finished();
+}
+
+QIODevice * ZipModel::Private::open(int row) {
+    Entry & entry = this->entries[row];
+    QIODevice * device = nullptr;
+    auto it = this->prefetched.find(row);
+    if (it != this->prefetched.end()) {
+        Prefetched ahead = it.value();
+        this->prefetched.erase(it);
+        this->prefetchedSize -= ahead.size;
+        // not started yet, read it here instead of waiting for its turn
+        if (!ahead.result->cancel()) {
+            device = ahead.result->take();
+        }
+    }
+    if (!device) {
+        device = this->read(entry);
+    }
+    if (!device->isSequential() && entry.width == 0 && entry.height == 0) {
+        // only parses the image header
+        QSize size = QImageReader(device).size();
+        device->seek(0);
+        if (size.isValid()) {
+            entry.width = size.width();
+            entry.height = size.height();
+            this->dirty = true;
+        }
+    }
+    this->prefetch(row + 1);
+    return device;
+}
+
+void ZipModel::Private::prefetch(int first) {
+    int last = std::min(first + PREFETCH_SIZE, static_cast<int>(this->entries.size()));
+    // forget the ones out of the window, e.g. after jumping back
+    for (auto it = this->prefetched.begin(); it != this->prefetched.end();) {
+        if (it.key() < first || it.key() >= last) {
+            it.value().result->cancel();
+            this->prefetchedSize -= it.value().size;
+            it = this->prefetched.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (int row = first; row < last; ++row) {
+        const Entry & entry = this->entries[row];
+        // stored entries are mapped, nothing to do ahead, unless split
+        if ((entry.method != ZipArchive::Deflated && !this->split) || this->prefetched.contains(row)) {
+            continue;
+        }
+        if (this->prefetchedSize + entry.size > PREFETCH_BUDGET) {
+            break;
+        }
+        std::shared_ptr<ZipArchive> archive = this->archive;
+        if (!entry.container.isEmpty()) {
+            ZipChapters::Nested inner;
+            if (!this->chapters->find(entry.container, inner)) {
+                // the chapter is inflated when its page is requested
+                continue;
+            }
+            archive = inner.archive;
+        }
+        Prefetched ahead;
+        ahead.result.reset(new InflatedEntry);
+        ahead.size = entry.size;
+        this->prefetched.insert(row, ahead);
+        this->prefetchedSize += ahead.size;
+        prefetchPool().start(new Inflater(archive, entry, ahead.result));
+    }
+}
+
+QIODevice * ZipModel::Private::read(const Entry & entry) {
+    try {
+        if (!entry.container.isEmpty()) {
+            ZipChapters::Nested inner;
+            if (this->chapters->find(entry.container, inner)) {
+                return this->readNested(entry, inner);
+            }
+            // inflating the chapter takes a while, do it on a worker
+            DeferredFile * device = new DeferredFile(QString());
+            ZipChapterReader * reader = new ZipChapterReader(this->chapters, entry);
+            device->connect(reader, SIGNAL(finished(const QByteArray &)), SLOT(complete(const QByteArray &)));
+            // owned by the loader, outlives the model
+            ExtractionScheduler::instance().start(reader, ExtractionScheduler::Foreground, nullptr);
+            return device;
+        }
+        if (entry.method == ZipArchive::Stored && !this->split) {
+            // stored entry is a plain file region, map it directly
+            MappedDevice * mapped = new MappedDevice(this->root.absoluteFilePath(), this->archive->getDataOffset(entry), entry.size);
+            if (mapped->isMapped()) {
+                return mapped;
+            }
+            delete mapped;
+        }
+        QBuffer * buffer = new QBuffer;
+        buffer->setData(this->archive->read(entry));
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    } catch (ArchiveException & e) {
+        qWarning() << e.getMessage();
+    }
+    QBuffer * buffer = new QBuffer;
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+QIODevice * ZipModel::Private::readNested(const Entry & entry, const ZipChapters::Nested & inner) {
+    QIODevice * mapped = mapNested(this->root.absoluteFilePath(), inner, entry);
+    if (mapped) {
+        // stored in stored, still a plain file region
+        return mapped;
+    }
+    QBuffer * buffer = new QBuffer;
+    buffer->setData(inner.archive->read(entry));
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+bool ZipModel::IsSupported(const QString & name) {
+    return name.endsWith(".zip") || name.endsWith(".cbz") || name.endsWith(".zip.001") || name.endsWith(".cbz.001");
+}
+
+ZipModel::ZipModel(const QFileInfo & root)
+    : FileModel()
+    , p_(new Private(this, root)) {
+    this->connect(this->p_.get(), SIGNAL(error(const QString &)), SIGNAL(error(const QString &)));
+    this->connect(this->p_.get(), SIGNAL(ready()), SIGNAL(ready()));
+    this->connect(this->p_.get(), SIGNAL(finished()), SIGNAL(finished()));
+}
+
+void ZipModel::doInitialize() {
+    if (this->p_->unlisted.isEmpty() || !this->p_->entries.empty()) {
+        // central directory was read on construction
+        this->p_->published = true;
+        emit this->ready();
+    }
+    if (!this->p_->unlisted.isEmpty()) {
+        this->p_->listChapters();
+    } else {
+        emit this->finished();
+    }
+}
+
+QModelIndex ZipModel::index(const QUrl & url) const {
+    QString name = QFileInfo(url.toLocalFile()).fileName();
+    for (int row = 0; row < this->rowCount(); ++row) {
+        if (QFileInfo(this->p_->entries[row].name).fileName() == name) {
+            return createIndex(row, 0, row);
+        }
+    }
+    return QModelIndex();
+}
+
+QModelIndex ZipModel::index(int row, int column, const QModelIndex & parent) const {
+    if (!parent.isValid()) {
+        // query from root
+        if (column == 0 && row >= 0 && row < this->rowCount()) {
+            return createIndex(row, 0, row);
+        } else {
+            return QModelIndex();
+        }
+    } else {
+        // other node has no child
+        return QModelIndex();
+    }
+}
+
+QModelIndex ZipModel::parent(const QModelIndex & /*child*/) const {
+    // flat list, every node is a child of root
+    return QModelIndex();
+}
+
+int ZipModel::rowCount(const QModelIndex & parent) const {
+    if (!parent.isValid()) {
+        // root row size
+        return this->p_->entries.size();
+    } else {
+        // others are leaf
+        return 0;
+    }
+}
+
+int ZipModel::columnCount(const QModelIndex & /*parent*/) const {
+    return 1;
+}
+
+QVariant ZipModel::data(const QModelIndex & index, int role) const {
+    if (!index.isValid() || index.column() != 0 || index.row() < 0 || index.row() >= this->rowCount()) {
+        return QVariant();
+    }
+    const Entry & entry = this->p_->entries[index.row()];
+    switch (role) {
+        case Qt::DisplayRole:
+            return entry.name;
+        case Qt::UserRole: {
+            QIODevice * fin = this->p_->open(index.row());
+            return QVariant::fromValue(fin);
+        }
+        default:
+            return QVariant();
+    }
+}
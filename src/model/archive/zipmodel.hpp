@@ -0,0 +1,89 @@
+/**
+ * @file zipmodel.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_ZIPMODEL_HPP
+#define KOMIX_MODEL_ARCHIVE_ZIPMODEL_HPP
+
+#include "filemodel.hpp"
+
+#include <QtCore/QFileInfo>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief The model to read ZIP archive in-process
+ *
+ * Each image entry is a row, and it is only decompressed when requested.
+ * Deflated entries following the requested one are inflated ahead on
+ * worker threads, within a small memory budget.
+ * The table of contents is cached, so reopening does not read the
+ * central directory again.
+ * Inner zip and cbz entries are read from the outer one without temporary
+ * files. Their pages are listed as chapters on a worker thread after the
+ * outer pages, and a chapter is only inflated for reading when one of its
+ * pages is requested. A chapter which can not be read is reported by the
+ * error signal.
+ * Archives written by komix-repack are listed from their leading index.
+ * Archives split into volumes are read through VolumeDevice.
+ * Supported file formats: zip, cbz, and their .001 volume sets.
+ */
+class ZipModel : public FileModel {
+public:
+    /**
+     * @brief check if @p name can be opened by this model
+     * @param name lower case file name
+     */
+    static bool IsSupported(const QString & name);
+
+    /**
+     * @brief Constructor with given fileinfo
+     * @param root archive file
+     * @throw KomiX::exception::ArchiveException if the archive can not be read in-process
+     */
+    explicit ZipModel(const QFileInfo & root);
+
+    /// Overrides from FileModel
+    virtual QModelIndex index(const QUrl & url) const;
+
+    /// Overrides from FileModel
+    virtual QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual QModelIndex parent(const QModelIndex & child) const;
+    /// Overrides from FileModel
+    virtual int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual int columnCount(const QModelIndex & parent = QModelIndex()) const;
+    /// Overrides from FileModel
+    virtual QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+protected:
+    virtual void doInitialize();
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+}
+} // end of namespace
+
+#endif
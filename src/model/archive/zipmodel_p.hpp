@@ -0,0 +1,207 @@
+/**
+ * @file zipmodel_p.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_MODEL_ARCHIVE_ZIPMODEL_P_HPP
+#define KOMIX_MODEL_ARCHIVE_ZIPMODEL_P_HPP
+
+#include "entry.hpp"
+#include "ziparchive.hpp"
+#include "zipmodel.hpp"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QStringList>
+
+#include <memory>
+#include <vector>
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+/**
+ * @brief An entry inflated ahead on a worker thread
+ *
+ * The worker claims it before inflating, so an entry which is requested
+ * before its turn can be canceled and read directly instead.
+ */
+class InflatedEntry : public QObject {
+    Q_OBJECT
+public:
+    InflatedEntry();
+
+    /// Called by the worker, false if it was canceled
+    bool claim();
+    /// Cancel it if the worker has not claimed it yet
+    bool cancel();
+    /// Called by the worker when done, @p data is empty on error
+    void set(const QByteArray & data);
+    /// Get the entry, a sequential device if the worker is still on it
+    QIODevice * take();
+
+signals:
+    void finished(const QByteArray & data);
+
+private:
+    enum State {
+        Waiting,
+        Running,
+        Finished,
+        Canceled
+    };
+
+    QMutex lock;
+    State state;
+    QByteArray data;
+};
+
+/// inner archives of a ZipModel, opened from any thread
+class ZipChapters {
+public:
+    struct Nested {
+        Nested()
+            : archive()
+            , base(-1) {
+        }
+
+        std::shared_ptr<ZipArchive> archive;
+        /// data offset of a stored inner archive in the file, -1 if inflated
+        qint64 base;
+    };
+
+    ZipChapters(const QString & path, std::shared_ptr<ZipArchive> archive, bool opened, bool split);
+
+    /// Get @p name if it is open already, never inflates
+    bool find(const QString & name, Nested & inner);
+    /**
+     * @brief Open @p name, inflated if it is not stored
+     * @param keep cache it for the following pages
+     * @throw KomiX::exception::ArchiveException if it can not be read
+     */
+    Nested open(const QString & name, bool keep);
+
+private:
+    QString path;
+    std::shared_ptr<ZipArchive> archive;
+    bool opened;
+    // split into volumes, offsets are not file offsets
+    bool split;
+    QMutex lock;
+    QHash<QString, Nested> nested;
+};
+
+/// pages found by a ZipChapterLister, taken by the model
+struct ZipChapterPages {
+    QMutex lock;
+    std::vector<Entry> pages;
+};
+
+/// lists inner archives on a worker thread
+class ZipChapterLister : public QObject, public QRunnable {
+    Q_OBJECT
+public:
+    ZipChapterLister(std::shared_ptr<ZipChapters> chapters, const QStringList & names, std::shared_ptr<ZipChapterPages> result);
+
+    virtual void run();
+
+signals:
+    /// pages of one more chapter are in the result
+    void listed();
+    void failed(const QString & message);
+    void finished();
+
+private:
+    std::shared_ptr<ZipChapters> chapters;
+    QStringList names;
+    std::shared_ptr<ZipChapterPages> result;
+};
+
+/// reads a page of a chapter which is not open yet
+class ZipChapterReader : public QObject, public QRunnable {
+    Q_OBJECT
+public:
+    ZipChapterReader(std::shared_ptr<ZipChapters> chapters, const Entry & entry);
+
+    virtual void run();
+
+signals:
+    /// @p data is empty if the page can not be read
+    void finished(const QByteArray & data);
+
+private:
+    // keeps the archive readable even if the model is gone
+    std::shared_ptr<ZipChapters> chapters;
+    Entry entry;
+};
+
+class ZipModel::Private : public QObject {
+    Q_OBJECT
+public:
+    Private(ZipModel * owner, const QFileInfo & root);
+    virtual ~Private();
+
+    struct Prefetched {
+        std::shared_ptr<InflatedEntry> result;
+        qint64 size;
+    };
+
+    bool isPage(const Entry & entry) const;
+    void listChapters();
+    void insertEntries(std::vector<Entry> & incoming);
+    QIODevice * open(int row);
+    QIODevice * read(const Entry & entry);
+    QIODevice * readNested(const Entry & entry, const ZipChapters::Nested & inner);
+    void prefetch(int row);
+
+public slots:
+    void onChapterListed();
+    void onChapterFailed(const QString & message);
+    void onChaptersFinished();
+
+signals:
+    void ready();
+    void finished();
+    void error(const QString &);
+
+public:
+    ZipModel * owner;
+    QFileInfo root;
+    QString key;
+    std::shared_ptr<ZipArchive> archive;
+    // split into volumes, offsets are not file offsets
+    bool split;
+    std::vector<Entry> entries;
+    // inner archives not listed yet
+    QStringList unlisted;
+    std::shared_ptr<ZipChapters> chapters;
+    std::shared_ptr<ZipChapterPages> listing;
+    bool published;
+    // a chapter could not be listed, the table of contents is not cached
+    bool broken;
+    bool dirty;
+    QHash<int, Prefetched> prefetched;
+    qint64 prefetchedSize;
+};
+}
+}
+}
+
+#endif
@@ -69,7 +69,10 @@ protected:
 
 signals:
     void error(const QString & msg);
+    /// The first rows can be shown, more may be inserted later
     void ready();
+    /// No more rows will be inserted
+    void finished();
 };
 }
 } // end namespace
@@ -20,6 +20,8 @@
  */
 #include "localfilemodel.hpp"
 #include "global.hpp"
+#include "mappeddevice.hpp"
+#include "memorystore.hpp"
 
 namespace KomiX {
 namespace model {
@@ -46,8 +48,25 @@ LocalFileModel::LocalFileModel(const QDir & root)
     , p_(new Private(root)) {
 }
 
+QIODevice * LocalFileModel::OpenFile(const QString & path) {
+    // extracted into memory
+    QIODevice * fin = MemoryStore::instance().open(path);
+    if (fin) {
+        return fin;
+    }
+    MappedDevice * mapped = new MappedDevice(path);
+    fin = mapped;
+    if (!mapped->isMapped()) {
+        delete mapped;
+        fin = new QFile(path);
+        fin->open(QIODevice::ReadOnly);
+    }
+    return fin;
+}
+
 void LocalFileModel::doInitialize() {
     emit this->ready();
+    emit this->finished();
 }
 
 void LocalFileModel::setRoot(const QDir & root) {
@@ -111,11 +130,8 @@ QVariant LocalFileModel::data(const QModelIndex & index, int role) const {
                 switch (role) {
                     case Qt::DisplayRole:
                         return this->p_->files[index.row()];
-                    case Qt::UserRole: {
-                        QIODevice * fin = new QFile(this->p_->root.filePath(this->p_->files[index.row()]));
-                        fin->open(QIODevice::ReadOnly);
-                        return QVariant::fromValue(fin);
-                    }
+                    case Qt::UserRole:
+                        return QVariant::fromValue(OpenFile(this->p_->root.filePath(this->p_->files[index.row()])));
                     default:
                         return QVariant();
                 }
@@ -40,6 +40,14 @@ public:
      */
     LocalFileModel(const QDir & root = QDir());
 
+    /**
+     * @brief Open the page at @p path for reading
+     *
+     * Pages held by MemoryStore are read from memory, others are mapped
+     * if possible.
+     */
+    static QIODevice * OpenFile(const QString & path);
+
     /// @brief Overrides from FileModel
     virtual QModelIndex index(const QUrl & url) const;
 
@@ -0,0 +1,93 @@
+/**
+ * @file deferredfile.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "deferredfile.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QFile>
+
+namespace KomiX {
+
+class DeferredFile::Private {
+public:
+    explicit Private(const QString & path);
+
+    QFile file;
+    QBuffer buffer;
+};
+}
+
+using KomiX::DeferredFile;
+
+DeferredFile::Private::Private(const QString & path)
+    : file(path)
+    , buffer() {
+}
+
+DeferredFile::DeferredFile(const QString & path, QObject * parent)
+    : QIODevice(parent)
+    , p_(new Private(path)) {
+    this->open(QIODevice::ReadOnly);
+}
+
+bool DeferredFile::isSequential() const {
+    return true;
+}
+
+qint64 DeferredFile::bytesAvailable() const {
+    qint64 size = this->QIODevice::bytesAvailable();
+    if (this->p_->file.isOpen()) {
+        size += this->p_->file.bytesAvailable();
+    }
+    if (this->p_->buffer.isOpen()) {
+        size += this->p_->buffer.bytesAvailable();
+    }
+    return size;
+}
+
+void DeferredFile::complete(bool ok) {
+    if (ok) {
+        this->p_->file.open(QIODevice::ReadOnly);
+    }
+    emit this->readyRead();
+    emit this->readChannelFinished();
+}
+
+void DeferredFile::complete(const QByteArray & data) {
+    this->p_->buffer.setData(data);
+    this->p_->buffer.open(QIODevice::ReadOnly);
+    emit this->readyRead();
+    emit this->readChannelFinished();
+}
+
+qint64 DeferredFile::readData(char * data, qint64 maxSize) {
+    if (this->p_->buffer.isOpen()) {
+        return this->p_->buffer.read(data, maxSize);
+    }
+    if (!this->p_->file.isOpen()) {
+        // nothing yet
+        return 0;
+    }
+    return this->p_->file.read(data, maxSize);
+}
+
+qint64 DeferredFile::writeData(const char * /*data*/, qint64 /*maxSize*/) {
+    return -1;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file deferredfile.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_UTILITY_DEFERREDFILE_HPP
+#define KOMIX_UTILITY_DEFERREDFILE_HPP
+
+#include <QtCore/QIODevice>
+
+#include <memory>
+
+namespace KomiX {
+
+/**
+ * @brief Sequential device of a file which is not written yet
+ *
+ * The device has no data until complete() is called, then it emits
+ * readyRead() and readChannelFinished() like a finished pipe, so it
+ * can be consumed by CharacterDeviceLoader. Data read elsewhere, such
+ * as a page inflated on a worker thread, can be handed over instead of
+ * the file.
+ */
+class DeferredFile : public QIODevice {
+    Q_OBJECT
+public:
+    /// Constructor with the path of the future file
+    explicit DeferredFile(const QString & path, QObject * parent = 0);
+
+    /// Overrides from QIODevice
+    virtual bool isSequential() const;
+    /// Overrides from QIODevice
+    virtual qint64 bytesAvailable() const;
+
+public slots:
+    /**
+     * @brief The file is written
+     * @param ok false if the file will never come, the device stays empty
+     */
+    void complete(bool ok);
+    /// The data is read, the file is not used
+    void complete(const QByteArray & data);
+
+protected:
+    virtual qint64 readData(char * data, qint64 maxSize);
+    virtual qint64 writeData(const char * data, qint64 maxSize);
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+
+#endif
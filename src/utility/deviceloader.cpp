@@ -21,6 +21,7 @@
 #include "blockdeviceloader.hpp"
 #include "characterdeviceloader.hpp"
 #include "deviceloader_p.hpp"
+#include "mappeddeviceloader.hpp"
 
 #include <QtCore/QBuffer>
 #include <QtCore/QThreadPool>
@@ -35,6 +36,7 @@ using KomiX::DeviceLoader;
 using KomiX::AsynchronousLoader;
 using KomiX::CharacterDeviceLoader;
 using KomiX::BlockDeviceLoader;
+using KomiX::MappedDeviceLoader;
 
 DeviceLoader::Private::Private(int id, QIODevice * device)
     : QObject()
@@ -64,6 +66,18 @@ void DeviceLoader::Private::onFinished(const QByteArray & data) {
     this->device->deleteLater();
 }
 
+void DeviceLoader::Private::onDecoded(const QImage & image) {
+    QPixmap pixmap = QPixmap::fromImage(image);
+    this->device->deleteLater();
+    emit this->finished(this->id, pixmap);
+}
+
+void DeviceLoader::Private::onAnimated() {
+    // the worker has read the header
+    this->device->seek(0);
+    this->read(this->device);
+}
+
 DeviceLoader::DeviceLoader(int id, QIODevice * device)
     : QObject()
     , p_(new Private(id, device)) {
@@ -73,7 +87,14 @@ DeviceLoader::DeviceLoader(int id, QIODevice * device)
 
 void DeviceLoader::start() const {
     AsynchronousLoader * loader = nullptr;
-    if (this->p_->device->isSequential()) {
+    if (qobject_cast<QBuffer *>(this->p_->device)) {
+        // memory backed device, decoded on a worker without copying
+        MappedDeviceLoader * mapped = new MappedDeviceLoader(this->p_->device);
+        this->p_->connect(mapped, SIGNAL(decoded(const QImage &)), SLOT(onDecoded(const QImage &)));
+        this->p_->connect(mapped, SIGNAL(animated()), SLOT(onAnimated()));
+        QThreadPool::globalInstance()->start(mapped);
+        return;
+    } else if (this->p_->device->isSequential()) {
         // character device, async operation
         loader = new CharacterDeviceLoader(this->p_->device);
     } else if (this->p_->device->size() >= MAX_DEVICE_SIZE) {
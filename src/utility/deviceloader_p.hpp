@@ -33,6 +33,8 @@ public:
 
 public slots:
     void onFinished(const QByteArray & data);
+    void onDecoded(const QImage & image);
+    void onAnimated();
 
 signals:
     void finished(int id, const QPixmap & pixmap);
@@ -18,26 +18,156 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include "archive/archivemodel.hpp"
+#include "characterdeviceloader.hpp"
 #include "exception.hpp"
 #include "filecontroller_p.hpp"
 #include "global.hpp"
 
+#include <QtCore/QBuffer>
+#include <QtCore/QDir>
 #include <QtCore/QFileInfo>
+#include <QtCore/QSettings>
+#include <QtCore/QThreadPool>
 
 #include <QtCore/QtDebug>
 
+#include <algorithm>
+
+namespace {
+
+/// start opening the next volume when this many pages are left
+const int NEAR_END = 3;
+/// pages of the next volume to read into memory before it is shown
+const int WARM_PAGES = 2;
+
+void release(QHash<int, KomiX::WarmPage *> & pages) {
+    foreach (KomiX::WarmPage * page, pages) {
+        QIODevice * device = page->take();
+        if (device) {
+            device->deleteLater();
+        }
+    }
+    pages.clear();
+}
+
+/// "vol2" before "vol10", case is ignored
+bool naturalLessThan(const QString & l, const QString & r) {
+    int i = 0;
+    int j = 0;
+    while (i < l.size() && j < r.size()) {
+        if (l.at(i).isDigit() && r.at(j).isDigit()) {
+            // by value, leading zeros aside
+            while (i < l.size() && l.at(i) == QLatin1Char('0')) {
+                ++i;
+            }
+            while (j < r.size() && r.at(j) == QLatin1Char('0')) {
+                ++j;
+            }
+            int m = i;
+            while (m < l.size() && l.at(m).isDigit()) {
+                ++m;
+            }
+            int n = j;
+            while (n < r.size() && r.at(n).isDigit()) {
+                ++n;
+            }
+            if (m - i != n - j) {
+                return m - i < n - j;
+            }
+            int c = l.midRef(i, m - i).compare(r.midRef(j, n - j));
+            if (c != 0) {
+                return c < 0;
+            }
+            i = m;
+            j = n;
+            continue;
+        }
+        QChar a = l.at(i).toCaseFolded();
+        QChar b = r.at(j).toCaseFolded();
+        if (a != b) {
+            return a < b;
+        }
+        ++i;
+        ++j;
+    }
+    if (i < l.size() || j < r.size()) {
+        return j < r.size();
+    }
+    // same apart from case and zeros
+    return l < r;
+}
+
+} // end of namespace
+
+using KomiX::CharacterDeviceLoader;
 using KomiX::FileController;
+using KomiX::WarmPage;
 using KomiX::model::FileModel;
 
+WarmPage::WarmPage(QIODevice * device)
+    : QObject()
+    , device(device)
+    , loading(false)
+    , dropped(false) {
+    if (!device->isSequential()) {
+        // read at once when shown
+        return;
+    }
+    // the loader deletes the device when it is read
+    CharacterDeviceLoader * loader = new CharacterDeviceLoader(device);
+    this->connect(loader, SIGNAL(finished(const QByteArray &)), SLOT(onLoaded(const QByteArray &)));
+    this->device = nullptr;
+    this->loading = true;
+    QThreadPool::globalInstance()->start(loader);
+}
+
+QIODevice * WarmPage::take() {
+    QIODevice * device = this->device;
+    this->device = nullptr;
+    if (this->loading) {
+        // deleted when the loader is done
+        this->dropped = true;
+    } else {
+        this->deleteLater();
+    }
+    return device;
+}
+
+void WarmPage::onLoaded(const QByteArray & data) {
+    this->loading = false;
+    if (this->dropped) {
+        this->deleteLater();
+        return;
+    }
+    // decoded in place by DeviceLoader
+    QBuffer * buffer = new QBuffer;
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    this->device = buffer;
+}
+
 FileController::Private::Private(FileController * owner)
     : QObject()
     , owner(owner)
     , index(0)
     , openingURL()
-    , model(NULL) {
+    , model(NULL)
+    , listed(false)
+    , warm()
+    , nextURL()
+    , nextModel()
+    , nextReady(false)
+    , nextListed(false)
+    , nextWarm() {
     this->owner->connect(this, SIGNAL(imageLoaded(QIODevice *)), SIGNAL(imageLoaded(QIODevice *)));
 }
 
+FileController::Private::~Private() {
+    this->discardNext();
+    this->discardWarm();
+}
+
 void FileController::Private::onModelReady() {
     if (this->owner->isEmpty()) {
         return;
@@ -52,9 +182,167 @@ void FileController::Private::onModelReady() {
     this->fromIndex(first);
 }
 
+void FileController::Private::onModelFinished() {
+    this->listed = true;
+    // a short book is near its end already
+    if (!this->owner->isEmpty() && this->index >= this->model->rowCount() - NEAR_END) {
+        this->prepareNext();
+    }
+}
+
+void FileController::Private::onRowsInserted(const QModelIndex & /*parent*/, int first, int last) {
+    // keep pointing to the same page while the model grows
+    if (first <= this->index && this->model->rowCount() > last - first + 1) {
+        this->index += last - first + 1;
+    }
+    if (!this->warm.isEmpty()) {
+        QHash<int, WarmPage *> shifted;
+        for (auto it = this->warm.begin(); it != this->warm.end(); ++it) {
+            shifted.insert((it.key() >= first) ? it.key() + last - first + 1 : it.key(), it.value());
+        }
+        this->warm.swap(shifted);
+    }
+}
+
+void FileController::Private::onNextReady() {
+    this->nextReady = true;
+    int n = qMin(WARM_PAGES, this->nextModel->rowCount());
+    for (int row = 0; row < n; ++row) {
+        // asking for the device is what unpacks the page
+        QIODevice * image = this->nextModel->index(row, 0).data(Qt::UserRole).value<QIODevice *>();
+        if (image) {
+            this->nextWarm.insert(row, new WarmPage(image));
+        }
+    }
+}
+
+void FileController::Private::onNextFinished() {
+    this->nextListed = true;
+}
+
+void FileController::Private::onNextError() {
+    if (this->sender() != this->nextModel.get()) {
+        return;
+    }
+    // nobody is looking at the next volume yet, so just give up on it
+    qDebug() << "can not prepare" << this->nextURL;
+    this->discardNext();
+}
+
 void FileController::Private::fromIndex(const QModelIndex & index) {
-    QIODevice * image = index.data(Qt::UserRole).value<QIODevice *>();
+    QIODevice * image = nullptr;
+    WarmPage * page = this->warm.take(index.row());
+    if (page) {
+        image = page->take();
+    }
+    if (!image) {
+        // not fetched ahead, or still being read
+        image = index.data(Qt::UserRole).value<QIODevice *>();
+    }
     emit this->imageLoaded(image);
+
+    // rows still being inserted do not count, the end is not known yet
+    if (this->listed && index.row() >= this->model->rowCount() - NEAR_END) {
+        this->prepareNext();
+    }
+}
+
+void FileController::Private::watch() {
+    this->connect(this->model.get(), SIGNAL(ready()), SLOT(onModelReady()));
+    this->connect(this->model.get(), SIGNAL(finished()), SLOT(onModelFinished()));
+    this->connect(this->model.get(), SIGNAL(rowsInserted(const QModelIndex &, int, int)), SLOT(onRowsInserted(const QModelIndex &, int, int)));
+    this->owner->connect(this->model.get(), SIGNAL(error(const QString &)), SIGNAL(errorOccured(const QString &)));
+}
+
+QUrl FileController::Private::findNextVolume() const {
+    if (!this->openingURL.isLocalFile()) {
+        return QUrl();
+    }
+    QFileInfo current(this->openingURL.toLocalFile());
+    if (!model::archive::isArchiveSupported(current.fileName().toLower())) {
+        return QUrl();
+    }
+    QDir parent(current.dir());
+    QStringList siblings = parent.entryList(model::archive::ArchiveFormatsFilter(), QDir::Files, QDir::NoSort);
+    std::sort(siblings.begin(), siblings.end(), naturalLessThan);
+    int i = siblings.indexOf(current.fileName());
+    if (i < 0) {
+        return QUrl();
+    }
+    for (++i; i < siblings.size(); ++i) {
+        // trailing volumes of a split set are not books
+        if (model::archive::isArchiveSupported(siblings.at(i).toLower())) {
+            return QUrl::fromLocalFile(parent.absoluteFilePath(siblings.at(i)));
+        }
+    }
+    return QUrl();
+}
+
+void FileController::Private::prepareNext() {
+    if (this->nextModel || !QSettings().value("auto_advance", false).toBool()) {
+        return;
+    }
+    QUrl url = this->findNextVolume();
+    if (url.isEmpty()) {
+        return;
+    }
+    try {
+        this->nextModel = FileModel::createModel(url);
+    } catch (exception::Exception & e) {
+        qDebug() << e.getMessage();
+        this->nextModel.reset();
+    }
+    if (!this->nextModel) {
+        return;
+    }
+    this->nextURL = url;
+    this->nextReady = false;
+    this->nextListed = false;
+    this->connect(this->nextModel.get(), SIGNAL(ready()), SLOT(onNextReady()));
+    this->connect(this->nextModel.get(), SIGNAL(finished()), SLOT(onNextFinished()));
+    // queued, the model must not be destroyed while it is emitting
+    this->connect(this->nextModel.get(), SIGNAL(error(const QString &)), SLOT(onNextError()), Qt::QueuedConnection);
+    this->nextModel->initialize();
+}
+
+bool FileController::Private::advance() {
+    if (!this->nextModel || (this->nextReady && this->nextModel->rowCount() == 0)) {
+        return false;
+    }
+    this->model->disconnect(this);
+    this->model->disconnect(this->owner);
+    this->nextModel->disconnect(this);
+    this->discardWarm();
+
+    this->model = this->nextModel;
+    this->listed = this->nextListed;
+    this->openingURL = this->nextURL;
+    this->warm.swap(this->nextWarm);
+    this->nextModel.reset();
+    this->nextURL.clear();
+    this->index = 0;
+    this->watch();
+
+    if (this->nextReady) {
+        this->fromIndex(this->model->index(0, 0));
+    }
+    // otherwise onModelReady() shows the first page when indexing is done
+    return true;
+}
+
+void FileController::Private::discardNext() {
+    release(this->nextWarm);
+    if (this->nextModel) {
+        this->nextModel->disconnect(this);
+        this->nextModel.reset();
+    }
+    this->nextURL.clear();
+    this->nextReady = false;
+    this->nextListed = false;
+}
+
+void FileController::Private::discardWarm() {
+    release(this->warm);
 }
 
 FileController::FileController(QObject * parent)
@@ -68,8 +356,10 @@ bool FileController::open(const QUrl & url) {
         if (!this->p_->model) {
             throw exception::Exception(QObject::tr("can not find a model for `%1`").arg(url.toString()));
         }
-        this->p_->connect(this->p_->model.get(), SIGNAL(ready()), SLOT(onModelReady()));
-        this->connect(this->p_->model.get(), SIGNAL(error(const QString &)), SIGNAL(errorOccured(const QString &)));
+        this->p_->discardNext();
+        this->p_->discardWarm();
+        this->p_->listed = false;
+        this->p_->watch();
         this->p_->openingURL = url;
         this->p_->model->initialize();
     } catch (exception::Exception & e) {
@@ -98,6 +388,9 @@ void FileController::next() {
     if (!this->isEmpty()) {
         ++this->p_->index;
         if (this->p_->index >= this->p_->model->rowCount()) {
+            if (this->p_->advance()) {
+                return;
+            }
             this->p_->index = 0;
         }
         QModelIndex item = this->p_->model->index(this->p_->index, 0);
@@ -68,6 +68,11 @@ public slots:
      *
      * This function well emit getImage( const QPixmap & ), and
      * prefetch images.
+     *
+     * With "auto_advance" set, the next archive in the same folder, in
+     * natural order, is opened near the last page with its first pages
+     * read into memory, and shown instead of wrapping around. The last
+     * page is known only after the model has finished listing.
      */
     void next();
     /**
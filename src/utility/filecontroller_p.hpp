@@ -23,17 +23,58 @@
 
 #include "filecontroller.hpp"
 
+#include <QtCore/QHash>
+
 namespace KomiX {
 
+/**
+ * @brief A page fetched ahead of time
+ *
+ * Sequential devices are read into memory by CharacterDeviceLoader as
+ * soon as they are fetched, so showing the page waits neither for the
+ * extraction nor for a device which has finished already.
+ */
+class WarmPage : public QObject {
+    Q_OBJECT
+public:
+    explicit WarmPage(QIODevice * device);
+
+    /**
+     * @brief Get the page and drop this object
+     * @return null if it is still being read, the caller owns it otherwise
+     */
+    QIODevice * take();
+
+public slots:
+    void onLoaded(const QByteArray & data);
+
+private:
+    QIODevice * device;
+    bool loading;
+    bool dropped;
+};
+
 class FileController::Private : public QObject {
     Q_OBJECT
 public:
     explicit Private(FileController * owner);
+    virtual ~Private();
 
     void fromIndex(const QModelIndex &);
+    void watch();
+    QUrl findNextVolume() const;
+    void prepareNext();
+    bool advance();
+    void discardNext();
+    void discardWarm();
 
 public slots:
     void onModelReady();
+    void onModelFinished();
+    void onRowsInserted(const QModelIndex & parent, int first, int last);
+    void onNextReady();
+    void onNextFinished();
+    void onNextError();
 
 signals:
     void imageLoaded(QIODevice * device);
@@ -43,6 +84,16 @@ public:
     int index;
     QUrl openingURL;
     std::shared_ptr<model::FileModel> model;
+    // every row of the current model is inserted
+    bool listed;
+    // pages fetched ahead of time, keyed by row of the current model
+    QHash<int, WarmPage *> warm;
+    // the following volume, opened while reading the end of this one
+    QUrl nextURL;
+    std::shared_ptr<model::FileModel> nextModel;
+    bool nextReady;
+    bool nextListed;
+    QHash<int, WarmPage *> nextWarm;
 };
 }
 
@@ -0,0 +1,77 @@
+/**
+ * @file mappeddevice.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mappeddevice.hpp"
+
+#include <QtCore/QFile>
+
+#include <limits>
+
+namespace KomiX {
+
+class MappedDevice::Private {
+public:
+    explicit Private(const QString & path);
+
+    QFile file;
+    uchar * address;
+};
+}
+
+using KomiX::MappedDevice;
+
+MappedDevice::Private::Private(const QString & path)
+    : file(path)
+    , address(nullptr) {
+}
+
+MappedDevice::MappedDevice(const QString & path, qint64 offset, qint64 size)
+    : QBuffer()
+    , p_(new Private(path)) {
+    if (!this->p_->file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    if (size < 0) {
+        size = this->p_->file.size() - offset;
+    }
+    if (size <= 0 || size > std::numeric_limits<int>::max()) {
+        // QByteArray can not hold it
+        return;
+    }
+    this->p_->address = this->p_->file.map(offset, size);
+    if (!this->p_->address) {
+        return;
+    }
+    // fromRawData does not copy, the buffer reads the mapped pages directly
+    this->setData(QByteArray::fromRawData(reinterpret_cast<const char *>(this->p_->address), size));
+    this->open(QIODevice::ReadOnly);
+}
+
+MappedDevice::~MappedDevice() {
+    this->close();
+    if (this->p_->address) {
+        this->setData(QByteArray());
+        this->p_->file.unmap(this->p_->address);
+    }
+}
+
+bool MappedDevice::isMapped() const {
+    return this->p_->address && this->isOpen();
+}
@@ -0,0 +1,56 @@
+/**
+ * @file mappeddevice.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_UTILITY_MAPPEDDEVICE_HPP
+#define KOMIX_UTILITY_MAPPEDDEVICE_HPP
+
+#include <QtCore/QBuffer>
+
+#include <memory>
+
+namespace KomiX {
+
+/**
+ * @brief Read-only device over a memory mapped file region
+ *
+ * The bytes are read straight from the page cache, no copy is made
+ * before decoding. The region is unmapped on destruction.
+ */
+class MappedDevice : public QBuffer {
+public:
+    /**
+     * @brief Map @p size bytes from @p offset of file @p path
+     * @param path file path
+     * @param offset begin of the region
+     * @param size size of the region, -1 means to the end of file
+     */
+    MappedDevice(const QString & path, qint64 offset = 0, qint64 size = -1);
+    virtual ~MappedDevice();
+
+    /// Check if the region is mapped and opened
+    bool isMapped() const;
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file memorystore.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mappeddevice.hpp"
+#include "memorystore.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSettings>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/// in MiB, disabled
+const qint64 DEFAULT_BUDGET = 0;
+
+} // end of namespace
+
+namespace KomiX {
+
+class MemoryStore::Private {
+public:
+    struct File {
+        File()
+            : fd(-1)
+            , data()
+            , size(0) {
+        }
+
+        /// memfd, -1 if data is held in the array
+        int fd;
+        QByteArray data;
+        qint64 size;
+    };
+
+    Private();
+    ~Private();
+
+    void close(const File & file);
+
+    mutable QMutex lock;
+    QHash<QString, File> files;
+    qint64 used;
+};
+}
+
+using KomiX::MemoryStore;
+
+MemoryStore::Private::Private()
+    : lock()
+    , files()
+    , used(0) {
+}
+
+MemoryStore::Private::~Private() {
+    foreach (File file, this->files) {
+        this->close(file);
+    }
+}
+
+void MemoryStore::Private::close(const File & file) {
+#ifdef Q_OS_LINUX
+    if (file.fd >= 0) {
+        ::close(file.fd);
+    }
+#else
+    Q_UNUSED(file);
+#endif
+}
+
+MemoryStore & MemoryStore::instance() {
+    static MemoryStore store;
+    return store;
+}
+
+MemoryStore::MemoryStore()
+    : p_(new Private) {
+}
+
+qint64 MemoryStore::getBudget() const {
+    return QSettings().value("memory_budget", DEFAULT_BUDGET).toLongLong() * 1024 * 1024;
+}
+
+bool MemoryStore::store(const QString & path, const QByteArray & data) {
+    qint64 budget = this->getBudget();
+    QMutexLocker locker(&this->p_->lock);
+    if (this->p_->files.contains(path) || this->p_->used + data.size() > budget) {
+        return false;
+    }
+
+    Private::File file;
+    file.size = data.size();
+#ifdef Q_OS_LINUX
+    // pages live in the page cache and are mapped without a copy
+    file.fd = memfd_create("komix", MFD_CLOEXEC);
+    if (file.fd >= 0) {
+        const char * p = data.constData();
+        qint64 left = data.size();
+        while (left > 0) {
+            ssize_t n = ::write(file.fd, p, left);
+            if (n <= 0) {
+                ::close(file.fd);
+                return false;
+            }
+            p += n;
+            left -= n;
+        }
+    }
+#endif
+    if (file.fd < 0) {
+        file.data = data;
+    }
+    this->p_->files.insert(path, file);
+    this->p_->used += file.size;
+    return true;
+}
+
+QIODevice * MemoryStore::open(const QString & path) const {
+    QMutexLocker locker(&this->p_->lock);
+    auto it = this->p_->files.find(path);
+    if (it == this->p_->files.end()) {
+        return nullptr;
+    }
+    QByteArray data = it->data;
+#ifdef Q_OS_LINUX
+    if (it->fd >= 0) {
+        // the mapping stays valid after the fd is closed
+        MappedDevice * mapped = new MappedDevice(QString("/proc/self/fd/%1").arg(it->fd));
+        if (mapped->isMapped()) {
+            return mapped;
+        }
+        delete mapped;
+        // /proc may be unavailable, the bytes are only in the memfd
+        data.resize(it->size);
+        qint64 done = 0;
+        while (done < it->size) {
+            ssize_t n = ::pread(it->fd, data.data() + done, it->size - done, done);
+            if (n <= 0) {
+                // the caller opens the cache file instead
+                return nullptr;
+            }
+            done += n;
+        }
+    }
+#endif
+    QBuffer * buffer = new QBuffer;
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+void MemoryStore::release(const QString & path) {
+    QString prefix = path + "/";
+    QMutexLocker locker(&this->p_->lock);
+    for (auto it = this->p_->files.begin(); it != this->p_->files.end();) {
+        if (it.key().startsWith(prefix)) {
+            this->p_->used -= it->size;
+            this->p_->close(*it);
+            it = this->p_->files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
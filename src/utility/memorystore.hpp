@@ -0,0 +1,66 @@
+/**
+ * @file memorystore.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_UTILITY_MEMORYSTORE_HPP
+#define KOMIX_UTILITY_MEMORYSTORE_HPP
+
+#include <QtCore/QIODevice>
+
+#include <memory>
+
+namespace KomiX {
+
+/**
+ * @brief Extracted files kept in anonymous memory
+ *
+ * A file is addressed by the path it would have on disk, so readers
+ * look here before opening the path. On Linux each file is a memfd which
+ * is mapped on open, elsewhere it is a byte array. The total size is
+ * limited by the "memory_budget" setting; writers spill to disk when a
+ * file does not fit.
+ */
+class MemoryStore {
+public:
+    /// Get the global store
+    static MemoryStore & instance();
+
+    /// Get budget in bytes, 0 means disabled
+    qint64 getBudget() const;
+    /**
+     * @brief Keep @p data as file @p path
+     * @return false if it does not fit the budget, write it to disk instead
+     */
+    bool store(const QString & path, const QByteArray & data);
+    /// Open file @p path for reading, nullptr if it is not in memory or can not be read
+    QIODevice * open(const QString & path) const;
+    /// Drop all files under directory @p path
+    void release(const QString & path);
+
+private:
+    MemoryStore();
+    MemoryStore(const MemoryStore &);
+    MemoryStore & operator=(const MemoryStore &);
+
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file filecontroller_test.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive/archivemodel.hpp"
+#include "filecontroller.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QFile>
+#include <QtCore/QPointer>
+#include <QtCore/QSettings>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+
+using KomiX::FileController;
+using KomiX::model::FileModel;
+
+/// a model which inserts its rows when told to, as the tar path does
+class StepModel : public FileModel {
+public:
+    explicit StepModel(const QUrl & url)
+        : FileModel()
+        , url(url)
+        , rows(0) {
+    }
+
+    using FileModel::index;
+    virtual QModelIndex index(const QUrl & /*url*/) const {
+        return QModelIndex();
+    }
+    virtual QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const {
+        if (parent.isValid() || column != 0 || row < 0 || row >= this->rows) {
+            return QModelIndex();
+        }
+        return this->createIndex(row, 0);
+    }
+    virtual QModelIndex parent(const QModelIndex & /*child*/) const {
+        return QModelIndex();
+    }
+    virtual int rowCount(const QModelIndex & parent = QModelIndex()) const {
+        return parent.isValid() ? 0 : this->rows;
+    }
+    virtual int columnCount(const QModelIndex & /*parent*/ = QModelIndex()) const {
+        return 1;
+    }
+    virtual QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const {
+        if (!index.isValid() || role != Qt::UserRole) {
+            return QVariant();
+        }
+        QBuffer * buffer = new QBuffer;
+        buffer->setData(QByteArray::number(index.row()));
+        buffer->open(QIODevice::ReadOnly);
+        return QVariant::fromValue<QIODevice *>(buffer);
+    }
+
+    /// insert @p n rows, the first ones make the model ready
+    void grow(int n) {
+        this->beginInsertRows(QModelIndex(), this->rows, this->rows + n - 1);
+        this->rows += n;
+        this->endInsertRows();
+        if (this->rows == n) {
+            emit this->ready();
+        }
+    }
+    void finish() {
+        emit this->finished();
+    }
+
+    QUrl url;
+
+protected:
+    virtual void doInitialize() {
+        // driven by the test
+    }
+
+private:
+    int rows;
+};
+
+QList<QPointer<StepModel>> & created() {
+    static QList<QPointer<StepModel>> models;
+    return models;
+}
+
+std::shared_ptr<FileModel> createStepModel(const QUrl & url) {
+    StepModel * model = new StepModel(url);
+    created().append(model);
+    return std::shared_ptr<FileModel>(model);
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace model {
+namespace archive {
+
+// the controller only needs to know which siblings are books
+
+const QStringList & ArchiveFormatsFilter() {
+    static QStringList filter("*.cbz");
+    return filter;
+}
+
+bool isArchiveSupported(const QString & path) {
+    return path.endsWith(".cbz");
+}
+}
+}
+}
+
+class FileControllerTest : public QObject {
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void waitsForListing();
+    void preparesShortBook();
+    void keepsListingOfNextVolume();
+
+private:
+    QUrl open(FileController & controller, const QString & name);
+
+    QTemporaryDir temp;
+    QList<QIODevice *> shown;
+};
+
+void FileControllerTest::initTestCase() {
+    QVERIFY(this->temp.isValid());
+    QCoreApplication::setOrganizationName("komix-test");
+    QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, this->temp.path());
+    QSettings().setValue("auto_advance", true);
+
+    QDir dir(this->temp.path());
+    foreach (QString name, QStringList() << "vol1.cbz" << "vol2.cbz" << "vol10.cbz") {
+        QFile fout(dir.filePath(name));
+        QVERIFY(fout.open(QIODevice::WriteOnly));
+    }
+    FileModel::registerModel([](const QUrl & url) -> bool { return url.isLocalFile(); }, createStepModel);
+}
+
+void FileControllerTest::init() {
+    created().clear();
+}
+
+void FileControllerTest::cleanup() {
+    qDeleteAll(this->shown);
+    this->shown.clear();
+}
+
+QUrl FileControllerTest::open(FileController & controller, const QString & name) {
+    this->connect(&controller, &FileController::imageLoaded, [this](QIODevice * device) -> void {
+        this->shown.append(device);
+    });
+    QUrl url = QUrl::fromLocalFile(QDir(this->temp.path()).filePath(name));
+    controller.open(url);
+    return url;
+}
+
+void FileControllerTest::waitsForListing() {
+    FileController controller(nullptr);
+    this->open(controller, "vol1.cbz");
+    QCOMPARE(created().size(), 1);
+    StepModel * model = created().at(0);
+
+    model->grow(1);
+    QCOMPARE(this->shown.size(), 1);
+    model->grow(2);
+    controller.next();
+    // three rows so far, but more are coming
+    QCOMPARE(created().size(), 1);
+
+    model->grow(20);
+    model->finish();
+    QCOMPARE(created().size(), 1);
+
+    // 23 rows, the next volume is opened three pages before the end
+    while (controller.getCurrentIndex().row() < 19) {
+        controller.next();
+    }
+    QCOMPARE(created().size(), 1);
+    controller.next();
+    QCOMPARE(created().size(), 2);
+    QCOMPARE(created().at(1)->url.fileName(), QString("vol2.cbz"));
+}
+
+void FileControllerTest::preparesShortBook() {
+    FileController controller(nullptr);
+    this->open(controller, "vol1.cbz");
+    StepModel * model = created().at(0);
+
+    model->grow(2);
+    QCOMPARE(created().size(), 1);
+    // the first page is near the end once nothing more comes
+    model->finish();
+    QCOMPARE(created().size(), 2);
+}
+
+void FileControllerTest::keepsListingOfNextVolume() {
+    FileController controller(nullptr);
+    this->open(controller, "vol1.cbz");
+    StepModel * model = created().at(0);
+    model->grow(2);
+    model->finish();
+    QCOMPARE(created().size(), 2);
+
+    // listed before it is shown, it reports nothing after that
+    StepModel * next = created().at(1);
+    next->grow(2);
+    next->finish();
+    controller.next();
+    controller.next();
+    QCOMPARE(controller.getModel().get(), static_cast<FileModel *>(next));
+    QCOMPARE(created().size(), 3);
+    QCOMPARE(created().at(2)->url.fileName(), QString("vol10.cbz"));
+}
+
+QTEST_GUILESS_MAIN(FileControllerTest)
+
+#include "filecontroller_test.moc"
@@ -52,6 +52,12 @@ void Preference::Private::loadSettings() {
 
     this->ui.pixelInterval->setValue(ini.value("pixel_interval", 1).toInt());
     this->ui.msInterval->setValue(ini.value("ms_interval", 1).toInt());
+    this->ui.streamArchive->setChecked(ini.value("stream_archive", false).toBool());
+    this->ui.seekGzip->setChecked(ini.value("seek_gzip", true).toBool());
+    this->ui.cacheBudget->setValue(ini.value("cache_budget", 1024).toInt());
+    this->ui.memoryBudget->setValue(ini.value("memory_budget", 0).toInt());
+    this->ui.extractionJobs->setValue(ini.value("extraction_jobs", 2).toInt());
+    this->ui.autoAdvance->setChecked(ini.value("auto_advance", false).toBool());
 }
 
 void Preference::Private::saveSettings() {
@@ -59,6 +65,12 @@ void Preference::Private::saveSettings() {
 
     ini.setValue("pixel_interval", this->ui.pixelInterval->value());
     ini.setValue("ms_interval", this->ui.msInterval->value());
+    ini.setValue("stream_archive", this->ui.streamArchive->isChecked());
+    ini.setValue("seek_gzip", this->ui.seekGzip->isChecked());
+    ini.setValue("cache_budget", this->ui.cacheBudget->value());
+    ini.setValue("memory_budget", this->ui.memoryBudget->value());
+    ini.setValue("extraction_jobs", this->ui.extractionJobs->value());
+    ini.setValue("auto_advance", this->ui.autoAdvance->isChecked());
 }
 
 Preference::Preference(QWidget * parent)
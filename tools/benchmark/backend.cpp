@@ -0,0 +1,291 @@
+/**
+ * @file backend.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "archivemodel.hpp"
+#include "backend_p.hpp"
+#include "compresseddevice.hpp"
+#include "extractioncache.hpp"
+#include "zipmodel.hpp"
+#ifdef KOMIX_HAVE_LIBARCHIVE
+#include "libarchivemodel.hpp"
+#endif
+
+#include <QtCore/QDirIterator>
+#include <QtCore/QSettings>
+#include <QtCore/QTimer>
+
+namespace {
+
+using KomiX::benchmark::ModelBackend;
+using KomiX::exception::ArchiveException;
+using KomiX::model::FileModel;
+using KomiX::model::archive::CompressedDevice;
+
+/// a page which takes longer is taken as lost
+const int TIMEOUT = 5 * 60 * 1000;
+
+qint64 dirSize(const QString & path) {
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
+
+/// same as the model factory, compressed tarballs do not need 7-Zip
+bool isCompressedTar(const QString & name) {
+    return name.endsWith("tar.gz") || name.endsWith("tgz") || name.endsWith("tar.bz2") || name.endsWith("tbz2") ||
+           name.endsWith("tar.lzma") || name.endsWith("tar.xz") || name.endsWith("txz");
+}
+
+/// ArchiveModel, entries are extracted with prefetch, or piped from 7-Zip and read from gzip tarballs in place when streaming
+class ArchiveBackend : public ModelBackend {
+public:
+    explicit ArchiveBackend(bool streaming)
+        : ModelBackend()
+        , streaming(streaming) {
+    }
+
+    virtual QString getName() const {
+        return this->streaming ? "7z-stream" : "7z-extract";
+    }
+
+    virtual bool accepts(const QString & archive) const {
+        bool runnable = isCompressedTar(archive.toLower()) || KomiX::model::archive::ArchiveModel::IsRunnable();
+        return runnable && KomiX::model::archive::ArchiveModel::IsPrepared();
+    }
+
+protected:
+    virtual std::shared_ptr<FileModel> create(const QFileInfo & archive) {
+        // read by the model when it is initialized
+        QSettings().setValue("stream_archive", this->streaming);
+        QSettings().setValue("seek_gzip", this->streaming);
+        return std::shared_ptr<FileModel>(new KomiX::model::archive::ArchiveModel(archive));
+    }
+
+private:
+    bool streaming;
+};
+
+/// ZipModel, entries are mapped or inflated in process
+class ZipBackend : public ModelBackend {
+public:
+    virtual QString getName() const {
+        return "zip";
+    }
+
+    virtual bool accepts(const QString & archive) const {
+        return KomiX::model::archive::ZipModel::IsSupported(archive.toLower());
+    }
+
+protected:
+    virtual std::shared_ptr<FileModel> create(const QFileInfo & archive) {
+        return std::shared_ptr<FileModel>(new KomiX::model::archive::ZipModel(archive));
+    }
+};
+
+#ifdef KOMIX_HAVE_LIBARCHIVE
+/// LibArchiveModel, pages behind the cursor are kept or decoded again from the beginning
+class LibArchiveBackend : public ModelBackend {
+public:
+    virtual QString getName() const {
+        return "libarchive";
+    }
+
+    virtual bool accepts(const QString & archive) const {
+        return KomiX::model::archive::LibArchiveModel::IsSupported(archive.toLower());
+    }
+
+protected:
+    virtual std::shared_ptr<FileModel> create(const QFileInfo & archive) {
+        return std::shared_ptr<FileModel>(new KomiX::model::archive::LibArchiveModel(archive));
+    }
+};
+#endif
+
+} // end of namespace
+
+namespace KomiX {
+namespace benchmark {
+
+Backend::~Backend() {
+}
+
+ModelBackend::ModelBackend()
+    : QObject()
+    , Backend()
+    , model()
+    , key()
+    , ready(false)
+    , finished(false)
+    , message()
+    , device(nullptr)
+    , data()
+    , loop(nullptr) {
+}
+
+void ModelBackend::open(const QString & archive) {
+    QFileInfo fi(archive);
+    this->key = KomiX::model::archive::getArchiveKey(fi);
+    this->ready = false;
+    this->message.clear();
+    this->model = this->create(fi);
+    this->connect(this->model.get(), SIGNAL(ready()), SLOT(onReady()));
+    this->connect(this->model.get(), SIGNAL(error(const QString &)), SLOT(onError(const QString &)));
+    this->connect(this->model.get(), SIGNAL(rowsInserted(const QModelIndex &, int, int)), SLOT(onChanged()));
+    this->connect(this->model.get(), SIGNAL(modelReset()), SLOT(onChanged()));
+    // ready at once if it was listed before
+    this->model->initialize();
+    while (!this->ready) {
+        this->wait();
+    }
+}
+
+QByteArray ModelBackend::read(const QString & name) {
+    int row = this->find(name);
+    while (row < 0) {
+        // pages of a tarball are published while it is unpacked
+        this->wait();
+        row = this->find(name);
+    }
+    QIODevice * device = this->model->data(this->model->index(row, 0), Qt::UserRole).value<QIODevice *>();
+    if (!device) {
+        throw ArchiveException(QString("can not open %1").arg(name));
+    }
+    // owned by the reader, as by a loader
+    std::shared_ptr<QIODevice> guard(device);
+    if (!device->isSequential()) {
+        return device->readAll();
+    }
+
+    this->device = device;
+    this->finished = false;
+    this->data.clear();
+    this->connect(device, SIGNAL(readyRead()), SLOT(onReadyRead()));
+    this->connect(device, SIGNAL(readChannelFinished()), SLOT(onReadFinished()));
+    try {
+        while (!this->finished) {
+            this->wait();
+        }
+    } catch (...) {
+        this->device = nullptr;
+        throw;
+    }
+    this->device = nullptr;
+    QByteArray data = this->data;
+    this->data.clear();
+    return data;
+}
+
+qint64 ModelBackend::getDiskUsage() const {
+    const KomiX::model::archive::ExtractionCache & cache = KomiX::model::archive::ExtractionCache::instance();
+    if (!cache.isPrepared() || this->key.isEmpty()) {
+        return 0;
+    }
+    return dirSize(cache.getRoot().absoluteFilePath(this->key));
+}
+
+void ModelBackend::close() {
+    // cancels the jobs of the model
+    this->model.reset();
+    this->key.clear();
+}
+
+void ModelBackend::onReady() {
+    this->ready = true;
+    if (this->loop) {
+        this->loop->quit();
+    }
+}
+
+void ModelBackend::onError(const QString & message) {
+    this->message = message.isEmpty() ? QString("unknown error") : message;
+    if (this->loop) {
+        this->loop->quit();
+    }
+}
+
+void ModelBackend::onChanged() {
+    if (this->loop) {
+        this->loop->quit();
+    }
+}
+
+void ModelBackend::onReadyRead() {
+    if (this->device) {
+        this->data.append(this->device->readAll());
+    }
+}
+
+void ModelBackend::onReadFinished() {
+    if (!this->device) {
+        return;
+    }
+    this->data.append(this->device->readAll());
+    this->finished = true;
+    if (this->loop) {
+        this->loop->quit();
+    }
+}
+
+int ModelBackend::find(const QString & name) const {
+    for (int row = 0; row < this->model->rowCount(); ++row) {
+        if (this->model->data(this->model->index(row, 0), Qt::DisplayRole).toString() == name) {
+            return row;
+        }
+    }
+    return -1;
+}
+
+void ModelBackend::wait() {
+    if (!this->message.isEmpty()) {
+        throw ArchiveException(this->message);
+    }
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    loop.connect(&timer, SIGNAL(timeout()), SLOT(quit()));
+    timer.start(TIMEOUT);
+    this->loop = &loop;
+    loop.exec();
+    this->loop = nullptr;
+    if (!this->message.isEmpty()) {
+        throw ArchiveException(this->message);
+    }
+    if (!timer.isActive()) {
+        throw ArchiveException("timed out");
+    }
+}
+
+std::vector<std::shared_ptr<Backend>> createBackends() {
+    std::vector<std::shared_ptr<Backend>> backends;
+    backends.push_back(std::shared_ptr<Backend>(new ArchiveBackend(false)));
+    backends.push_back(std::shared_ptr<Backend>(new ArchiveBackend(true)));
+    backends.push_back(std::shared_ptr<Backend>(new ZipBackend));
+#ifdef KOMIX_HAVE_LIBARCHIVE
+    backends.push_back(std::shared_ptr<Backend>(new LibArchiveBackend));
+#endif
+    return backends;
+}
+}
+}
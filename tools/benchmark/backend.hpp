@@ -0,0 +1,67 @@
+/**
+ * @file backend.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_TOOLS_BENCHMARK_BACKEND_HPP
+#define KOMIX_TOOLS_BENCHMARK_BACKEND_HPP
+
+#include <QtCore/QString>
+
+#include <memory>
+#include <vector>
+
+namespace KomiX {
+namespace benchmark {
+
+/**
+ * @brief One way KomiX reads pages out of an archive
+ *
+ * Each backend drives a model of the viewer, so the numbers follow the
+ * viewer, including its cache, prefetching and worker threads.
+ */
+class Backend {
+public:
+    virtual ~Backend();
+
+    /// name in the report
+    virtual QString getName() const = 0;
+    /// check if @p archive can be read this way
+    virtual bool accepts(const QString & archive) const = 0;
+    /**
+     * @brief Open @p archive and wait until it is listed
+     * @throw KomiX::exception::ArchiveException on failure
+     */
+    virtual void open(const QString & archive) = 0;
+    /**
+     * @brief Read page @p name, waiting for it if it is not ready
+     * @throw KomiX::exception::ArchiveException on failure
+     */
+    virtual QByteArray read(const QString & name) = 0;
+    /// Get bytes written to the extraction cache for the open archive
+    virtual qint64 getDiskUsage() const = 0;
+    /// Stop any background work and forget the archive
+    virtual void close() = 0;
+};
+
+/// Create every backend built in
+std::vector<std::shared_ptr<Backend>> createBackends();
+}
+} // end of namespace
+
+#endif
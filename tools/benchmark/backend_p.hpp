@@ -0,0 +1,76 @@
+/**
+ * @file backend_p.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_TOOLS_BENCHMARK_BACKEND_HPP_
+#define KOMIX_TOOLS_BENCHMARK_BACKEND_HPP_
+
+#include "backend.hpp"
+#include "filemodel.hpp"
+
+#include <QtCore/QEventLoop>
+#include <QtCore/QFileInfo>
+
+namespace KomiX {
+namespace benchmark {
+
+/**
+ * @brief Reads pages through a model, as FileController does
+ *
+ * Signals of the model and of its devices are delivered by a nested
+ * event loop, so a page which is still extracted is waited for.
+ */
+class ModelBackend : public QObject, public Backend {
+    Q_OBJECT
+public:
+    ModelBackend();
+
+    virtual void open(const QString & archive);
+    virtual QByteArray read(const QString & name);
+    virtual qint64 getDiskUsage() const;
+    virtual void close();
+
+protected:
+    /// Create the model of @p archive, not initialized yet
+    virtual std::shared_ptr<KomiX::model::FileModel> create(const QFileInfo & archive) = 0;
+
+private slots:
+    void onReady();
+    void onError(const QString & message);
+    void onChanged();
+    void onReadyRead();
+    void onReadFinished();
+
+private:
+    int find(const QString & name) const;
+    void wait();
+
+    std::shared_ptr<KomiX::model::FileModel> model;
+    QString key;
+    bool ready;
+    bool finished;
+    QString message;
+    QIODevice * device;
+    QByteArray data;
+    QEventLoop * loop;
+};
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file benchmark.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "benchmark.hpp"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+const double MIB = 1024.0 * 1024.0;
+const double NSECS_PER_MSEC = 1000.0 * 1000.0;
+
+/// a fresh copy of @p archive for one measurement, the cache is keyed by inode
+QString prepare(const QString & archive, const QDir & temp, const QString & name) {
+    QDir dir(temp.absoluteFilePath(name));
+    dir.removeRecursively();
+    temp.mkpath(name);
+    QString path = dir.absoluteFilePath(QFileInfo(archive).fileName());
+    if (!QFile::copy(archive, path)) {
+        throw KomiX::exception::ArchiveException(QString("can not copy %1").arg(archive));
+    }
+    return path;
+}
+
+/// keeps the archive open in a scope, closes it even if a read throws
+class Session {
+public:
+    Session(KomiX::benchmark::Backend & backend, const QString & archive)
+        : backend(backend) {
+        backend.open(archive);
+    }
+    ~Session() {
+        this->backend.close();
+    }
+
+private:
+    Session(const Session &);
+    Session & operator=(const Session &);
+
+    KomiX::benchmark::Backend & backend;
+};
+
+} // end of namespace
+
+namespace KomiX {
+namespace benchmark {
+
+Result measure(Backend & backend, const QString & archive, const QStringList & pages, const QDir & temp, int samples) {
+    Result result;
+    QElapsedTimer timer;
+
+    {
+        QString book = prepare(archive, temp, "first");
+        timer.start();
+        Session session(backend, book);
+        backend.read(pages.first());
+        result.firstPage = timer.elapsed();
+        result.peakDisk = std::max(result.peakDisk, backend.getDiskUsage());
+    }
+
+    {
+        QString book = prepare(archive, temp, "scan");
+        qint64 bytes = 0;
+        timer.start();
+        Session session(backend, book);
+        foreach (QString page, pages) {
+            bytes += backend.read(page).size();
+        }
+        double seconds = std::max<qint64>(1, timer.nsecsElapsed()) / (NSECS_PER_MSEC * 1000.0);
+        result.throughput = bytes / MIB / seconds;
+        // files are only added while reading, the end is the peak
+        result.peakDisk = std::max(result.peakDisk, backend.getDiskUsage());
+    }
+
+    {
+        QString book = prepare(archive, temp, "random");
+        Session session(backend, book);
+        // same pages for every backend
+        std::mt19937 engine(1);
+        std::uniform_int_distribution<int> pick(0, pages.size() - 1);
+        double total = 0.0;
+        for (int i = 0; i < samples; ++i) {
+            QString page = pages.at(pick(engine));
+            timer.start();
+            backend.read(page);
+            double latency = timer.nsecsElapsed() / NSECS_PER_MSEC;
+            total += latency;
+            result.randomMax = std::max(result.randomMax, latency);
+        }
+        result.randomMean = samples > 0 ? total / samples : 0.0;
+        result.peakDisk = std::max(result.peakDisk, backend.getDiskUsage());
+    }
+
+    return result;
+}
+}
+}
@@ -0,0 +1,66 @@
+/**
+ * @file benchmark.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_TOOLS_BENCHMARK_BENCHMARK_HPP
+#define KOMIX_TOOLS_BENCHMARK_BENCHMARK_HPP
+
+#include "backend.hpp"
+
+#include <QtCore/QDir>
+#include <QtCore/QStringList>
+
+namespace KomiX {
+namespace benchmark {
+
+/// Numbers of one backend on one book
+struct Result {
+    Result()
+        : firstPage(0)
+        , throughput(0.0)
+        , randomMean(0.0)
+        , randomMax(0.0)
+        , peakDisk(0) {
+    }
+
+    /// milliseconds from opening to the first page read
+    qint64 firstPage;
+    /// MiB per second when reading every page in order
+    double throughput;
+    /// mean milliseconds of reading a random page
+    double randomMean;
+    /// worst milliseconds of reading a random page
+    double randomMax;
+    /// bytes written to the extraction cache at most
+    qint64 peakDisk;
+};
+
+/**
+ * @brief Measure @p backend on @p archive
+ *
+ * Every measurement opens a fresh copy of the book under @p temp, so
+ * nothing extracted or listed by an earlier one is reused.
+ * @param samples number of random pages
+ * @throw KomiX::exception::ArchiveException on failure
+ */
+Result measure(Backend & backend, const QString & archive, const QStringList & pages, const QDir & temp, int samples);
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file corpus.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "corpus.hpp"
+
+#include <QtCore/QProcess>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QtDebug>
+#include <QtGui/QImage>
+
+#include <random>
+
+namespace {
+
+const int PAGE_WIDTH = 1200;
+const int PAGE_HEIGHT = 1700;
+const int JPEG_QUALITY = 85;
+/// size of the checker pattern, the noise alone would not compress
+const int CELL_SIZE = 40;
+
+using KomiX::exception::ArchiveException;
+
+void run(const QString & program, const QStringList & args, const QDir & cwd) {
+    QProcess p;
+    p.setWorkingDirectory(cwd.absolutePath());
+    p.start(program, args, QIODevice::ReadOnly);
+    if (!p.waitForFinished(-1) || p.exitStatus() != QProcess::NormalExit || p.exitCode() != 0) {
+        QString err = QString::fromLocal8Bit(p.readAllStandardError());
+        throw ArchiveException(err.isEmpty() ? p.errorString() : err);
+    }
+}
+
+QImage drawPage(int index, std::mt19937 & engine) {
+    QImage image(PAGE_WIDTH, PAGE_HEIGHT, QImage::Format_RGB32);
+    std::uniform_int_distribution<int> noise(-24, 24);
+    for (int y = 0; y < PAGE_HEIGHT; ++y) {
+        QRgb * line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < PAGE_WIDTH; ++x) {
+            int base = ((x / CELL_SIZE + y / CELL_SIZE + index) % 2 == 0) ? 230 : 40;
+            int v = qBound(0, base + noise(engine), 255);
+            line[x] = qRgb(v, v, v);
+        }
+    }
+    return image;
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace benchmark {
+
+class Corpus::Private {
+public:
+    QStringList pages;
+    QStringList archives;
+};
+}
+}
+
+using KomiX::benchmark::Corpus;
+
+Corpus::Corpus(const QDir & root, int pages)
+    : p_(new Private) {
+    QString sevenZip = QStandardPaths::findExecutable("7z");
+    if (sevenZip.isEmpty()) {
+        throw ArchiveException("7-Zip is not found");
+    }
+
+    root.mkpath("pages");
+    QDir spool(root.absoluteFilePath("pages"));
+    // same pages on every run
+    std::mt19937 engine(1);
+    for (int i = 1; i <= pages; ++i) {
+        QString name = QString("page%1.jpg").arg(i, 4, 10, QChar('0'));
+        if (!drawPage(i, engine).save(spool.absoluteFilePath(name), "JPEG", JPEG_QUALITY)) {
+            throw ArchiveException(QString("can not write %1").arg(name));
+        }
+        this->p_->pages << name;
+    }
+
+    QString zip = root.absoluteFilePath("book.zip");
+    run(sevenZip, QStringList() << "a"
+                                << "-tzip" << zip << "*.jpg",
+        spool);
+    this->p_->archives << zip;
+    QString sz = root.absoluteFilePath("book.7z");
+    run(sevenZip, QStringList() << "a"
+                                << "-t7z" << sz << "*.jpg",
+        spool);
+    this->p_->archives << sz;
+
+    QString rar = QStandardPaths::findExecutable("rar");
+    if (rar.isEmpty()) {
+        qWarning() << "RAR is not found, skip rar books";
+    } else {
+        QString book = root.absoluteFilePath("book.rar");
+        run(rar, QStringList() << "a"
+                               << "-ep"
+                               << "-idq" << book << "*.jpg",
+            spool);
+        this->p_->archives << book;
+    }
+
+    QString tar = root.absoluteFilePath("book.tar");
+    run(sevenZip, QStringList() << "a"
+                                << "-ttar" << tar << "*.jpg",
+        spool);
+    this->p_->archives << tar;
+    QString gz = root.absoluteFilePath("book.tar.gz");
+    run(sevenZip, QStringList() << "a"
+                                << "-tgzip" << gz << tar,
+        root);
+    this->p_->archives << gz;
+    QString bz2 = root.absoluteFilePath("book.tar.bz2");
+    run(sevenZip, QStringList() << "a"
+                                << "-tbzip2" << bz2 << tar,
+        root);
+    this->p_->archives << bz2;
+}
+
+const QStringList & Corpus::getPages() const {
+    return this->p_->pages;
+}
+
+const QStringList & Corpus::getArchives() const {
+    return this->p_->archives;
+}
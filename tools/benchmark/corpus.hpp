@@ -0,0 +1,61 @@
+/**
+ * @file corpus.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_TOOLS_BENCHMARK_CORPUS_HPP
+#define KOMIX_TOOLS_BENCHMARK_CORPUS_HPP
+
+#include <QtCore/QDir>
+#include <QtCore/QStringList>
+
+#include <memory>
+
+namespace KomiX {
+namespace benchmark {
+
+/**
+ * @brief Generated comic books, the same pages in every format
+ *
+ * Pages are noisy JPEG images of a scanned page size, so compression
+ * ratios are close to real ones. They are packed by 7-Zip into zip, 7z,
+ * tar, tar.gz and tar.bz2, and by RAR if it is installed.
+ */
+class Corpus {
+public:
+    /**
+     * @brief Generate the corpus in @p root
+     * @param root empty directory
+     * @param pages number of pages of each book
+     * @throw KomiX::exception::ArchiveException if a book can not be packed
+     */
+    Corpus(const QDir & root, int pages);
+
+    /// page names in reading order
+    const QStringList & getPages() const;
+    /// book paths
+    const QStringList & getArchives() const;
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+} // end of namespace
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file main.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "backend.hpp"
+#include "benchmark.hpp"
+#include "corpus.hpp"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSettings>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QTextStream>
+#include <QtCore/QtDebug>
+
+namespace {
+
+const double MIB = 1024.0 * 1024.0;
+
+} // end of namespace
+
+int main(int argc, char * argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("komix-benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measure every archive backend of KomiX over a generated corpus.");
+    parser.addHelpOption();
+    QCommandLineOption pagesOption(QStringList() << "n"
+                                                 << "pages",
+                                   "Generate books of <n> pages.", "n", "60");
+    QCommandLineOption samplesOption(QStringList() << "s"
+                                                   << "samples",
+                                     "Read <n> random pages for the latency.", "n", "16");
+    QCommandLineOption corpusOption(QStringList() << "c"
+                                                  << "corpus",
+                                    "Generate the corpus in <dir> and keep it.", "dir");
+    parser.addOption(pagesOption);
+    parser.addOption(samplesOption);
+    parser.addOption(corpusOption);
+    parser.process(app);
+
+    QTemporaryDir scratch;
+    if (!scratch.isValid()) {
+        qCritical() << "can not create temporary directory";
+        return 1;
+    }
+    QDir root(scratch.path());
+    root.mkpath("corpus");
+    root.mkpath("temp");
+    root.mkpath("cache");
+    root.mkpath("settings");
+    // models keep their cache and settings here, not in the ones of the viewer
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(root.absoluteFilePath("cache")));
+#else
+    QStandardPaths::setTestModeEnabled(true);
+#endif
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, root.absoluteFilePath("settings"));
+    QDir temp(root.absoluteFilePath("temp"));
+    QDir books(parser.isSet(corpusOption) ? parser.value(corpusOption) : root.absoluteFilePath("corpus"));
+    books.mkpath(".");
+
+    QTextStream out(stdout);
+    int failures = 0;
+    try {
+        KomiX::benchmark::Corpus corpus(books, qMax(1, parser.value(pagesOption).toInt()));
+        int samples = qMax(1, parser.value(samplesOption).toInt());
+
+        out << QString("%1 %2 %3 %4 %5 %6 %7")
+                   .arg("backend", -12)
+                   .arg("book", -14)
+                   .arg("first(ms)", 10)
+                   .arg("scan(MiB/s)", 12)
+                   .arg("random(ms)", 11)
+                   .arg("max(ms)", 9)
+                   .arg("disk(MiB)", 10)
+            << endl;
+        for (const auto & backend : KomiX::benchmark::createBackends()) {
+            foreach (QString archive, corpus.getArchives()) {
+                if (!backend->accepts(archive)) {
+                    continue;
+                }
+                QString book = QFileInfo(archive).fileName();
+                try {
+                    KomiX::benchmark::Result result = KomiX::benchmark::measure(*backend, archive, corpus.getPages(), temp, samples);
+                    out << QString("%1 %2 %3 %4 %5 %6 %7")
+                               .arg(backend->getName(), -12)
+                               .arg(book, -14)
+                               .arg(result.firstPage, 10)
+                               .arg(result.throughput, 12, 'f', 1)
+                               .arg(result.randomMean, 11, 'f', 1)
+                               .arg(result.randomMax, 9, 'f', 1)
+                               .arg(result.peakDisk / MIB, 10, 'f', 1)
+                        << endl;
+                } catch (KomiX::exception::ArchiveException & e) {
+                    out << QString("%1 %2 failed: %3").arg(backend->getName(), -12).arg(book, -14).arg(e.getMessage()) << endl;
+                    ++failures;
+                }
+            }
+        }
+    } catch (KomiX::exception::ArchiveException & e) {
+        qCritical() << e.getMessage();
+        ++failures;
+    }
+
+    // links made by ArchiveModel, and whatever the cache evicted
+    KomiX::model::archive::delTree(KomiX::model::archive::getTmpDir());
+    KomiX::model::archive::stopSweeping();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file main.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "repacker.hpp"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+#include <memory>
+
+int main(int argc, char * argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("komix-repack");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Rewrite archives as stored CBZ files which KomiX opens without decompression.");
+    parser.addHelpOption();
+    QCommandLineOption outputOption(QStringList() << "o"
+                                                  << "output",
+                                    "Write CBZ files to <dir> instead of next to the inputs.", "dir");
+    QCommandLineOption jobsOption(QStringList() << "j"
+                                                << "jobs",
+                                  "Repack <n> archives at once.", "n", QString::number(QThread::idealThreadCount()));
+    parser.addOption(outputOption);
+    parser.addOption(jobsOption);
+    parser.addPositionalArgument("archives", "Archives to repack.", "archive...");
+    parser.process(app);
+
+    QStringList inputs = parser.positionalArguments();
+    if (inputs.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QThreadPool * pool = QThreadPool::globalInstance();
+    pool->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+    std::shared_ptr<QAtomicInt> failures(new QAtomicInt(0));
+    foreach (QString input, inputs) {
+        QFileInfo file(input);
+        QDir output = parser.isSet(outputOption) ? QDir(parser.value(outputOption)) : file.absoluteDir();
+        pool->start(new KomiX::repack::Repacker(file.absoluteFilePath(), output, failures));
+    }
+    pool->waitForDone();
+
+    return failures->load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,454 @@
+/**
+ * @file repacker.cpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "archive.hpp"
+#include "compresseddevice.hpp"
+#include "packindex.hpp"
+#include "repacker.hpp"
+#include "tarreader.hpp"
+#include "ziparchive.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QDateTime>
+#include <QtCore/QDirIterator>
+#include <QtCore/QMutex>
+#include <QtCore/QProcess>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QTextStream>
+#include <QtCore/QtEndian>
+#include <QtGui/QImageReader>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace {
+
+using KomiX::exception::ArchiveException;
+using KomiX::model::archive::CompressedDevice;
+using KomiX::model::archive::Entry;
+using KomiX::model::archive::ZipArchive;
+
+const qint64 CHUNK_SIZE = 256 * 1024;
+const quint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const quint32 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+const quint32 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+const qint64 LOCAL_HEADER_SIZE = 30;
+const quint16 VERSION_STORED = 10;
+const quint16 FLAG_UTF8 = 0x0800;
+/// ZIP64 is not written
+const qint64 MAX_OFFSET = 0xFFFFFFFFLL;
+const int MAX_COUNT = 0xFFFF;
+
+struct Page {
+    QString name;
+    std::function<QByteArray()> read;
+};
+
+const QStringList & imageSuffixes() {
+    static QStringList suffixes = []() -> QStringList {
+        QStringList tmp;
+        foreach (QByteArray format, QImageReader::supportedImageFormats()) {
+            tmp << QString::fromLatin1(format).toLower();
+        }
+        return tmp;
+    }();
+    return suffixes;
+}
+
+bool isImage(const QString & name) {
+    return !name.endsWith('/') && imageSuffixes().contains(QFileInfo(name).suffix().toLower());
+}
+
+bool isZip(const QString & name) {
+    return name.endsWith(".zip") || name.endsWith(".cbz");
+}
+
+bool isCompressedTar(const QString & name, CompressedDevice::Format & format) {
+    if (name.endsWith(".tar.gz") || name.endsWith(".tgz")) {
+        format = CompressedDevice::Gzip;
+    } else if (name.endsWith(".tar.bz2") || name.endsWith(".tbz2")) {
+        format = CompressedDevice::Bzip2;
+    } else if (name.endsWith(".tar.xz") || name.endsWith(".txz") || name.endsWith(".tar.lzma")) {
+        format = CompressedDevice::Xz;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/// reject absolute paths and paths escaping the spool directory
+QString sanitize(const QString & name) {
+    QString path = QDir::cleanPath(QDir::fromNativeSeparators(name));
+    if (path.isEmpty() || QDir::isAbsolutePath(path) || path == ".." || path.startsWith("../")) {
+        return QString();
+    }
+    return path;
+}
+
+quint32 checksum(const QByteArray & data) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    return crc32(crc, reinterpret_cast<const Bytef *>(data.constData()), data.size());
+}
+
+void put16(QByteArray & buffer, quint16 value) {
+    uchar tmp[2];
+    qToLittleEndian(value, tmp);
+    buffer.append(reinterpret_cast<const char *>(tmp), sizeof(tmp));
+}
+
+void put32(QByteArray & buffer, quint32 value) {
+    uchar tmp[4];
+    qToLittleEndian(value, tmp);
+    buffer.append(reinterpret_cast<const char *>(tmp), sizeof(tmp));
+}
+
+class Stamp {
+public:
+    explicit Stamp(const QDateTime & dt)
+        : time((dt.time().hour() << 11) | (dt.time().minute() << 5) | (dt.time().second() / 2))
+        , date((std::max(dt.date().year() - 1980, 0) << 9) | (dt.date().month() << 5) | dt.date().day()) {
+    }
+
+    quint16 time;
+    quint16 date;
+};
+
+QByteArray localHeader(const QByteArray & name, quint32 crc, quint32 size, const Stamp & stamp) {
+    QByteArray header;
+    put32(header, LOCAL_HEADER_SIGNATURE);
+    put16(header, VERSION_STORED);
+    put16(header, FLAG_UTF8);
+    put16(header, ZipArchive::Stored);
+    put16(header, stamp.time);
+    put16(header, stamp.date);
+    put32(header, crc);
+    put32(header, size);
+    put32(header, size);
+    put16(header, name.size());
+    put16(header, 0);
+    header.append(name);
+    return header;
+}
+
+QByteArray centralHeader(const QByteArray & name, quint32 crc, quint32 size, quint32 offset, const Stamp & stamp) {
+    QByteArray header;
+    put32(header, CENTRAL_HEADER_SIGNATURE);
+    put16(header, VERSION_STORED);
+    put16(header, VERSION_STORED);
+    put16(header, FLAG_UTF8);
+    put16(header, ZipArchive::Stored);
+    put16(header, stamp.time);
+    put16(header, stamp.date);
+    put32(header, crc);
+    put32(header, size);
+    put32(header, size);
+    put16(header, name.size());
+    // extra, comment, disk, internal and external attributes
+    put16(header, 0);
+    put16(header, 0);
+    put16(header, 0);
+    put16(header, 0);
+    put32(header, 0);
+    put32(header, offset);
+    header.append(name);
+    return header;
+}
+
+void report(const QString & message) {
+    static QMutex lock;
+    QMutexLocker locker(&lock);
+    Q_UNUSED(locker);
+    QTextStream(stdout) << message << endl;
+}
+
+} // end of namespace
+
+namespace KomiX {
+namespace repack {
+
+class Repacker::Private {
+public:
+    Private(const QString & input, const QDir & output, std::shared_ptr<QAtomicInt> failures);
+
+    QString getOutputPath() const;
+    void listZip(std::vector<Page> & pages);
+    void spoolTar(QIODevice * device, const QDir & spool);
+    void spoolSevenZip(const QDir & spool);
+    void listSpool(const QDir & spool, std::vector<Page> & pages);
+    void write(const QString & path, std::vector<Page> & pages);
+
+    QString input;
+    QDir output;
+    std::shared_ptr<QAtomicInt> failures;
+};
+}
+}
+
+using KomiX::repack::Repacker;
+
+Repacker::Private::Private(const QString & input, const QDir & output, std::shared_ptr<QAtomicInt> failures)
+    : input(input)
+    , output(output)
+    , failures(failures) {
+}
+
+QString Repacker::Private::getOutputPath() const {
+    static const char * const SUFFIXES[] = {".tar.gz", ".tar.bz2", ".tar.lzma", ".tar.xz", ".tgz", ".tbz2", ".txz", ".tar",
+                                            ".7z",     ".rar",     ".zip",      ".cbz",    ".cbr", ".cb7",  ".cbt"};
+    QString base = QFileInfo(this->input).fileName();
+    for (const char * suffix : SUFFIXES) {
+        if (base.toLower().endsWith(suffix)) {
+            base.chop(qstrlen(suffix));
+            break;
+        }
+    }
+    return this->output.filePath(base + ".cbz");
+}
+
+void Repacker::Private::listZip(std::vector<Page> & pages) {
+    std::shared_ptr<QIODevice> fin(new QFile(this->input));
+    if (!fin->open(QIODevice::ReadOnly)) {
+        throw ArchiveException(fin->errorString());
+    }
+    std::shared_ptr<ZipArchive> archive(new ZipArchive(fin));
+    archive->open();
+    for (const Entry & entry : archive->getEntries()) {
+        if (isImage(entry.name)) {
+            pages.push_back(Page{entry.name, [archive, entry]() -> QByteArray { return archive->read(entry); }});
+            continue;
+        }
+        if (entry.name.endsWith('/') || !isZip(entry.name.toLower())) {
+            continue;
+        }
+        // chapters are flattened, as ZipModel lists them
+        std::shared_ptr<QBuffer> buffer(new QBuffer);
+        buffer->setData(archive->read(entry));
+        buffer->open(QIODevice::ReadOnly);
+        std::shared_ptr<ZipArchive> inner(new ZipArchive(buffer));
+        inner->open();
+        for (const Entry & page : inner->getEntries()) {
+            if (isImage(page.name)) {
+                pages.push_back(Page{entry.name + "/" + page.name, [inner, page]() -> QByteArray { return inner->read(page); }});
+            }
+        }
+    }
+}
+
+void Repacker::Private::spoolTar(QIODevice * device, const QDir & spool) {
+    KomiX::model::archive::TarReader reader(device);
+    QByteArray chunk(CHUNK_SIZE, '\0');
+    Entry entry;
+    while (reader.next(entry)) {
+        QString name = sanitize(entry.name);
+        if (name.isEmpty() || !isImage(name)) {
+            continue;
+        }
+        QString path = spool.filePath(name);
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile fout(path);
+        if (!fout.open(QIODevice::WriteOnly)) {
+            throw ArchiveException(fout.errorString());
+        }
+        qint64 n = 0;
+        while ((n = reader.read(chunk.data(), chunk.size())) > 0) {
+            if (fout.write(chunk.constData(), n) != n) {
+                throw ArchiveException(fout.errorString());
+            }
+        }
+    }
+}
+
+void Repacker::Private::spoolSevenZip(const QDir & spool) {
+    QString program = QStandardPaths::findExecutable("7z");
+    if (program.isEmpty()) {
+        throw ArchiveException("7-Zip is not found");
+    }
+    QProcess p;
+    p.start(program, QStringList() << "x"
+                                   << "-y" << QString("-o%1").arg(spool.absolutePath()) << "--" << this->input,
+            QIODevice::ReadOnly);
+    if (!p.waitForFinished(-1) || p.exitStatus() != QProcess::NormalExit || p.exitCode() != 0) {
+        QString err = QString::fromLocal8Bit(p.readAllStandardError());
+        throw ArchiveException(err.isEmpty() ? p.errorString() : err);
+    }
+}
+
+void Repacker::Private::listSpool(const QDir & spool, std::vector<Page> & pages) {
+    QDirIterator it(spool.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+        QString name = spool.relativeFilePath(path);
+        if (!isImage(name)) {
+            continue;
+        }
+        pages.push_back(Page{name, [path]() -> QByteArray {
+                                 QFile fin(path);
+                                 if (!fin.open(QIODevice::ReadOnly)) {
+                                     throw ArchiveException(fin.errorString());
+                                 }
+                                 return fin.readAll();
+                             }});
+    }
+}
+
+void Repacker::Private::write(const QString & path, std::vector<Page> & pages) {
+    // reading order, same as the viewer
+    std::sort(pages.begin(), pages.end(), [](const Page & l, const Page & r) -> bool {
+        return QString::compare(l.name, r.name, Qt::CaseInsensitive) < 0;
+    });
+    if (static_cast<int>(pages.size()) >= MAX_COUNT) {
+        throw ArchiveException("too many pages");
+    }
+    std::vector<Entry> entries(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i) {
+        entries[i].name = pages[i].name;
+        entries[i].method = ZipArchive::Stored;
+    }
+    Stamp stamp(QFileInfo(this->input).lastModified());
+    QByteArray indexName(KomiX::model::archive::PACK_INDEX_NAME);
+    // the index is written last, its size is already known
+    qint64 indexSize = KomiX::model::archive::savePackIndex(entries).size();
+
+    QFile fout(path);
+    if (!fout.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        throw ArchiveException(fout.errorString());
+    }
+    qint64 cursor = LOCAL_HEADER_SIZE + indexName.size() + indexSize;
+    if (fout.write(QByteArray(cursor, '\0')) != cursor) {
+        throw ArchiveException(fout.errorString());
+    }
+    for (size_t i = 0; i < pages.size(); ++i) {
+        QByteArray data = pages[i].read();
+        Entry & entry = entries[i];
+        entry.offset = cursor;
+        entry.size = entry.packedSize = data.size();
+        entry.crc32 = checksum(data);
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QSize size = QImageReader(&buffer).size();
+        if (size.isValid()) {
+            entry.width = size.width();
+            entry.height = size.height();
+        }
+
+        QByteArray header = localHeader(entry.name.toUtf8(), entry.crc32, entry.size, stamp);
+        cursor += header.size() + data.size();
+        if (cursor > MAX_OFFSET) {
+            throw ArchiveException("archive is too large");
+        }
+        if (fout.write(header) != header.size() || fout.write(data) != data.size()) {
+            throw ArchiveException(fout.errorString());
+        }
+    }
+
+    QByteArray index = KomiX::model::archive::savePackIndex(entries);
+    Q_ASSERT(index.size() == indexSize);
+    quint32 indexCrc = checksum(index);
+    QByteArray directory = centralHeader(indexName, indexCrc, index.size(), 0, stamp);
+    for (const Entry & entry : entries) {
+        directory.append(centralHeader(entry.name.toUtf8(), entry.crc32, entry.size, entry.offset, stamp));
+    }
+    if (cursor + directory.size() > MAX_OFFSET) {
+        throw ArchiveException("archive is too large");
+    }
+    QByteArray end;
+    put32(end, END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+    put16(end, 0);
+    put16(end, 0);
+    put16(end, entries.size() + 1);
+    put16(end, entries.size() + 1);
+    put32(end, directory.size());
+    put32(end, cursor);
+    put16(end, 0);
+    if (fout.write(directory) != directory.size() || fout.write(end) != end.size()) {
+        throw ArchiveException(fout.errorString());
+    }
+
+    // fill the reserved room at the front
+    QByteArray head = localHeader(indexName, indexCrc, index.size(), stamp);
+    if (!fout.seek(0) || fout.write(head) != head.size() || fout.write(index) != index.size()) {
+        throw ArchiveException(fout.errorString());
+    }
+    fout.close();
+    if (fout.error() != QFileDevice::NoError) {
+        throw ArchiveException(fout.errorString());
+    }
+}
+
+Repacker::Repacker(const QString & input, const QDir & output, std::shared_ptr<QAtomicInt> failures)
+    : QRunnable()
+    , p_(new Private(input, output, failures)) {
+}
+
+void Repacker::run() {
+    QString target = this->p_->getOutputPath();
+    QString partial = target + ".part";
+    try {
+        {
+            // sequential formats are unpacked here first
+            QTemporaryDir spool;
+            std::vector<Page> pages;
+            QString name = QFileInfo(this->p_->input).fileName().toLower();
+            CompressedDevice::Format format;
+            if (isZip(name)) {
+                this->p_->listZip(pages);
+            } else {
+                if (!spool.isValid()) {
+                    throw ArchiveException("can not make temporary directory");
+                }
+                std::shared_ptr<QIODevice> fin(new QFile(this->p_->input));
+                if (isCompressedTar(name, format)) {
+                    if (!fin->open(QIODevice::ReadOnly)) {
+                        throw ArchiveException(fin->errorString());
+                    }
+                    CompressedDevice device(fin, format);
+                    device.open(QIODevice::ReadOnly);
+                    this->p_->spoolTar(&device, spool.path());
+                } else if (name.endsWith(".tar")) {
+                    if (!fin->open(QIODevice::ReadOnly)) {
+                        throw ArchiveException(fin->errorString());
+                    }
+                    this->p_->spoolTar(fin.get(), spool.path());
+                } else {
+                    this->p_->spoolSevenZip(spool.path());
+                }
+                this->p_->listSpool(spool.path(), pages);
+            }
+            if (pages.empty()) {
+                throw ArchiveException("no page found");
+            }
+            this->p_->write(partial, pages);
+            // the input is closed here, so it can be replaced
+        }
+        QFile::remove(target);
+        if (!QFile::rename(partial, target)) {
+            throw ArchiveException(QString("can not write %1").arg(target));
+        }
+        report(QString("%1 -> %2").arg(this->p_->input).arg(target));
+    } catch (ArchiveException & e) {
+        QFile::remove(partial);
+        qWarning("%s: %s", qPrintable(this->p_->input), qPrintable(e.getMessage()));
+        this->p_->failures->ref();
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * @file repacker.hpp
+ * @author Wei-Cheng Pan
+ *
+ * KomiX, a comics viewer.
+ * Copyright (C) 2008  Wei-Cheng Pan <legnaleurc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KOMIX_TOOLS_REPACK_REPACKER_HPP
+#define KOMIX_TOOLS_REPACK_REPACKER_HPP
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QDir>
+#include <QtCore/QRunnable>
+
+#include <memory>
+
+namespace KomiX {
+namespace repack {
+
+/**
+ * @brief Rewrites one archive as a stored CBZ
+ *
+ * Pages are written uncompressed in reading order, after an index entry
+ * which lists them with offsets, checksums and image sizes. Readers can
+ * map every page in place and never scan the central directory.
+ * Runs in a thread pool, one archive per job.
+ */
+class Repacker : public QRunnable {
+public:
+    /**
+     * @brief Constructor
+     * @param input any archive KomiX can read
+     * @param output directory of the new CBZ
+     * @param failures increased if this job fails
+     */
+    Repacker(const QString & input, const QDir & output, std::shared_ptr<QAtomicInt> failures);
+
+    virtual void run();
+
+private:
+    class Private;
+    std::shared_ptr<Private> p_;
+};
+}
+} // end of namespace
+
+#endif